@@ -0,0 +1,106 @@
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arena.h"
+#include "fatal.h"
+
+#define BLOCK_SIZE 65536
+#define ALIGNMENT alignof(max_align_t)
+
+typedef struct block *Block;
+struct block
+{
+	Block next;
+	size_t used;
+	size_t size;
+	alignas(max_align_t) char data[];
+};
+
+struct arena
+{
+	Block blocks; // the block memory is currently taken from, then older ones
+	size_t total; // the number of bytes allocated from the system
+};
+
+static Block newBlock(size_t size);
+
+////////////////////////////////////////////////////////////////////////
+
+Arena ArenaNew(void)
+{
+	Arena a = malloc(sizeof(*a));
+	if (a == NULL)
+	{
+		fatalError("out of memory");
+	}
+	a->blocks = NULL;
+	a->total = 0;
+	return a;
+}
+
+void ArenaFree(Arena a)
+{
+	Block b = a->blocks;
+	while (b != NULL)
+	{
+		Block temp = b;
+		b = b->next;
+		free(temp);
+	}
+	free(a);
+}
+
+void *ArenaAlloc(Arena a, size_t size)
+{
+	size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	Block b = a->blocks;
+	if (b == NULL || b->size - b->used < size)
+	{
+		// requests bigger than a block get a block of their own, placed
+		// behind the current one so it can still be used
+		b = newBlock(size > BLOCK_SIZE ? size : BLOCK_SIZE);
+		a->total += sizeof(*b) + b->size;
+		if (a->blocks != NULL && size > BLOCK_SIZE)
+		{
+			b->next = a->blocks->next;
+			a->blocks->next = b;
+		}
+		else
+		{
+			b->next = a->blocks;
+			a->blocks = b;
+		}
+	}
+
+	void *p = &b->data[b->used];
+	b->used += size;
+	return p;
+}
+
+char *ArenaStrndup(Arena a, const char *s, size_t len)
+{
+	char *copy = ArenaAlloc(a, len + 1);
+	memcpy(copy, s, len);
+	copy[len] = '\0';
+	return copy;
+}
+
+size_t ArenaSize(Arena a)
+{
+	return a->total;
+}
+
+static Block newBlock(size_t size)
+{
+	Block b = malloc(sizeof(*b) + size);
+	if (b == NULL)
+	{
+		fatalError("out of memory");
+	}
+	b->used = 0;
+	b->size = size;
+	return b;
+}
@@ -0,0 +1,31 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// A bump allocator. Memory is handed out from large blocks and can only
+// be freed all at once, by freeing the arena.
+typedef struct arena *Arena;
+
+// Creates a new empty arena
+// Complexity: O(1)
+Arena ArenaNew(void);
+
+// Frees the arena and all memory allocated from it
+// Complexity: O(number of blocks)
+void ArenaFree(Arena a);
+
+// Allocates size bytes, suitably aligned for any type
+// Complexity: O(1)
+void *ArenaAlloc(Arena a, size_t size);
+
+// Copies the first len characters of s into the arena and null-terminates
+// the copy
+// Complexity: O(len)
+char *ArenaStrndup(Arena a, const char *s, size_t len);
+
+// Returns the total number of bytes allocated from the system
+// Complexity: O(1)
+size_t ArenaSize(Arena a);
+
+#endif
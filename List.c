@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "List.h"
+#include "fatal.h"
 
 typedef struct node *Node;
 struct node
@@ -30,8 +31,7 @@ List ListNew(void)
 	List l = malloc(sizeof(*l));
 	if (l == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
 
 	l->head = NULL;
@@ -75,8 +75,7 @@ static Node newNode(char *s)
 	Node n = malloc(sizeof(*n));
 	if (n == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
 
 	n->s = myStrdup(s);
@@ -89,8 +88,7 @@ static char *myStrdup(char *s)
 	char *copy = malloc((strlen(s) + 1) * sizeof(char));
 	if (copy == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
 	return strcpy(copy, s);
 }
@@ -107,8 +105,7 @@ void ListSort(List l)
 	char **items = malloc(l->size * sizeof(char *));
 	if (items == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
 	int i = 0;
 	for (Node curr = l->head; curr != NULL; curr = curr->next)
@@ -155,8 +152,7 @@ ListIterator ListItNew(List l)
 	ListIterator it = malloc(sizeof(*it));
 	if (it == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
 
 	it->curr = l->head;
@@ -169,8 +165,7 @@ char *ListItNext(ListIterator it)
 {
 	if (it->curr == NULL)
 	{
-		fprintf(stderr, "error: no more items in iterator!\n");
-		exit(EXIT_FAILURE);
+		fatalError("no more items in iterator!");
 	}
 
 	char *item = it->curr->s;
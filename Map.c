@@ -1,42 +1,65 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "Arena.h"
 #include "Map.h"
+#include "fatal.h"
 
-typedef struct node *Node;
-struct node
+#define INITIAL_CAPACITY 16 // must be a power of two
+
+// A slot of the hash table. Empty slots have a NULL key.
+struct slot
 {
-	char *key;
-	int value;
-	Node left;
-	Node right;
+	char *key;	   // the key, stored in the map's arena
+	uint32_t hash; // the cached hash of the key
+	int value;	   // the value associated with the key
 };
 
 struct map
 {
-	Node root;
+	struct slot *slots;	// open addressing table with linear probing
+	int capacity;		// the number of slots, always a power of two
+	int size;			// the number of keys in the map
+	Arena keys;			// the arena keys are copied into
+	bool ownsKeys;		// whether the arena is freed with the map
 };
 
-static void doFree(Node n);
-static Node doSet(Node n, char *key, int value);
-static Node newNode(char *key, int value);
-static char *myStrdup(char *s);
-static bool doContains(Node n, char *key);
-static int doGet(Node n, char *key);
+static uint32_t hashKey(const char *key, size_t len);
+static struct slot *findSlot(Map m, const char *key, size_t len,
+							 uint32_t hash);
+static void grow(Map m);
 
 ////////////////////////////////////////////////////////////////////////
 // Creates a new map
 
 Map MapNew(void)
+{
+	Map m = MapNewInArena(ArenaNew());
+	m->ownsKeys = true;
+	return m;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Creates a new map which copies its keys into the given arena
+
+Map MapNewInArena(Arena a)
 {
 	Map m = malloc(sizeof(*m));
 	if (m == NULL)
 	{
-		fprintf(stderr, "Insufficient memory!\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
-	m->root = NULL;
+	m->slots = calloc(INITIAL_CAPACITY, sizeof(struct slot));
+	if (m->slots == NULL)
+	{
+		fatalError("out of memory");
+	}
+	m->capacity = INITIAL_CAPACITY;
+	m->size = 0;
+	m->keys = a;
+	m->ownsKeys = false;
 	return m;
 }
 
@@ -45,142 +68,176 @@ Map MapNew(void)
 
 void MapFree(Map m)
 {
-	doFree(m->root);
-	free(m);
-}
-
-static void doFree(Node n)
-{
-	if (n != NULL)
+	if (m->ownsKeys)
 	{
-		doFree(n->left);
-		doFree(n->right);
-		free(n->key);
-		free(n);
+		ArenaFree(m->keys);
 	}
+	free(m->slots);
+	free(m);
 }
 
 ////////////////////////////////////////////////////////////////////////
 // Adds  a  key-value  pair to the map. If the key already exists in the
 // map, its value is replaced with the given value. Makes a copy of  the
-// key.
-// Complexity: Assume O(log n) (even though it isn't)
+// key and returns the map's copy.
+// Complexity: O(1) expected
 
-void MapSet(Map m, char *key, int value)
+char *MapSet(Map m, char *key, int value)
 {
-	m->root = doSet(m->root, key, value);
+	size_t len = strlen(key);
+	uint32_t hash = hashKey(key, len);
+	struct slot *s = findSlot(m, key, len, hash);
+	if (s->key != NULL)
+	{
+		s->value = value;
+		return s->key;
+	}
+
+	char *copy = ArenaStrndup(m->keys, key, len);
+	s->key = copy;
+	s->hash = hash;
+	s->value = value;
+	m->size++;
+	// keep the table at most 70% full
+	if (m->size * 10 > m->capacity * 7)
+	{
+		grow(m);
+	}
+	return copy;
 }
 
-static Node doSet(Node n, char *key, int value)
+// Finds the slot holding the given key, or the empty slot where it would
+// be inserted.
+static struct slot *findSlot(Map m, const char *key, size_t len,
+							 uint32_t hash)
 {
-	if (n == NULL)
+	uint32_t mask = m->capacity - 1;
+	for (uint32_t i = hash & mask;; i = (i + 1) & mask)
 	{
-		return newNode(key, value);
+		struct slot *s = &m->slots[i];
+		if (s->key == NULL ||
+			(s->hash == hash && strncmp(s->key, key, len) == 0 &&
+			 s->key[len] == '\0'))
+		{
+			return s;
+		}
 	}
+}
 
-	int cmp = strcmp(key, n->key);
-	if (cmp < 0)
+// Doubles the number of slots and reinserts every key using its cached
+// hash.
+static void grow(Map m)
+{
+	int newCapacity = m->capacity * 2;
+	struct slot *newSlots = calloc(newCapacity, sizeof(struct slot));
+	if (newSlots == NULL)
 	{
-		n->left = doSet(n->left, key, value);
+		fatalError("out of memory");
 	}
-	else if (cmp > 0)
+
+	uint32_t mask = newCapacity - 1;
+	for (int i = 0; i < m->capacity; i++)
 	{
-		n->right = doSet(n->right, key, value);
-	}
-	else
-	{ // (cmp == 0)
-		n->value = value;
-	}
-	return n;
+		struct slot *s = &m->slots[i];
+		if (s->key != NULL)
+		{
+			uint32_t j = s->hash & mask;
+			while (newSlots[j].key != NULL)
+			{
+				j = (j + 1) & mask;
+			}
+			newSlots[j] = *s;
+		}
+	}
+	free(m->slots);
+	m->slots = newSlots;
+	m->capacity = newCapacity;
 }
 
-static Node newNode(char *key, int value)
+// Hashes the first len characters of the key with 32-bit FNV-1a.
+static uint32_t hashKey(const char *key, size_t len)
 {
-	Node n = malloc(sizeof(*n));
-	if (n == NULL)
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
 	{
-		fprintf(stderr, "Insufficient memory!\n");
-		exit(EXIT_FAILURE);
+		hash ^= (unsigned char)key[i];
+		hash *= 16777619u;
 	}
-
-	n->key = myStrdup(key);
-	n->value = value;
-	n->left = NULL;
-	n->right = NULL;
-	return n;
+	return hash;
 }
 
-static char *myStrdup(char *s)
+////////////////////////////////////////////////////////////////////////
+// Removes the given key from the map. Returns true if it was there. The
+// copy of the key stays in the arena until the arena is freed.
+// Complexity: O(1) expected
+
+bool MapRemove(Map m, char *key)
 {
-	char *copy = malloc((strlen(s) + 1) * sizeof(char));
-	if (copy == NULL)
+	size_t len = strlen(key);
+	struct slot *s = findSlot(m, key, len, hashKey(key, len));
+	if (s->key == NULL)
 	{
-		fprintf(stderr, "Insufficient memory!\n");
-		exit(EXIT_FAILURE);
+		return false;
 	}
-	return strcpy(copy, s);
+	s->key = NULL;
+	m->size--;
+
+	// shift back the keys after the hole that can no longer be reached
+	// from their home slot, so no tombstones are needed
+	uint32_t mask = m->capacity - 1;
+	uint32_t hole = s - m->slots;
+	for (uint32_t i = (hole + 1) & mask; m->slots[i].key != NULL;
+		 i = (i + 1) & mask)
+	{
+		uint32_t home = m->slots[i].hash & mask;
+		if (((i - home) & mask) >= ((i - hole) & mask))
+		{
+			m->slots[hole] = m->slots[i];
+			m->slots[i].key = NULL;
+			hole = i;
+		}
+	}
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////
 // Checks if the map contains the given key
-// Complexity: Assume O(log n) (even though it isn't)
+// Complexity: O(1) expected
 
 bool MapContains(Map m, char *key)
 {
-	return doContains(m->root, key);
+	size_t len = strlen(key);
+	return findSlot(m, key, len, hashKey(key, len))->key != NULL;
 }
 
-static bool doContains(Node n, char *key)
+////////////////////////////////////////////////////////////////////////
+// Looks up a key given as the first len characters of key, which need
+// not be null-terminated.
+// Complexity: O(1) expected
+
+bool MapFind(Map m, const char *key, size_t len, int *value)
 {
-	if (n == NULL)
+	struct slot *s = findSlot(m, key, len, hashKey(key, len));
+	if (s->key == NULL)
 	{
 		return false;
 	}
-
-	int cmp = strcmp(key, n->key);
-	if (cmp < 0)
-	{
-		return doContains(n->left, key);
-	}
-	else if (cmp > 0)
-	{
-		return doContains(n->right, key);
-	}
-	else
-	{
-		return true;
-	}
+	*value = s->value;
+	return true;
 }
 
 ////////////////////////////////////////////////////////////////////////
 // Gets  the  value associated with the given key. The key is assumed to
 // exist.
-// Complexity: Assume O(log n) (even though it isn't)
+// Complexity: O(1) expected
 
 int MapGet(Map m, char *key)
 {
-	return doGet(m->root, key);
-}
-
-static int doGet(Node n, char *key)
-{
-	if (n == NULL)
-	{
-		fprintf(stderr, "KeyError: '%s' not found\n", key);
-		exit(EXIT_FAILURE);
-	}
-
-	int cmp = strcmp(key, n->key);
-	if (cmp < 0)
-	{
-		return doGet(n->left, key);
-	}
-	else if (cmp > 0)
-	{
-		return doGet(n->right, key);
-	}
-	else
+	size_t len = strlen(key);
+	struct slot *s = findSlot(m, key, len, hashKey(key, len));
+	if (s->key == NULL)
 	{
-		return n->value;
+		fatalError("key \'%s\' not found", key);
 	}
+	return s->value;
 }
@@ -2,30 +2,51 @@
 #define MAP_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
+#include "Arena.h"
+
+// A hash map from strings to ints. Keys are copied into an arena and
+// their hashes are cached.
 typedef struct map *Map;
 
 // Creates a new map
 // Complexity: O(1)
 Map MapNew(void);
 
+// Creates a new map which copies its keys into the given arena. The keys
+// stay valid until the arena is freed, even after the map is freed.
+// Complexity: O(1)
+Map MapNewInArena(Arena a);
+
 // Frees all memory allocated for the given map
 // Complexity: O(n)
 void MapFree(Map m);
 
 // Adds  a  key-value  pair to the map. If the key already exists in the
 // map, its value is replaced with the given value. Makes a copy of  the
-// key.
-// Complexity: Assume O(log n) (even though it isn't)
-void MapSet(Map m, char *key, int value);
+// key and returns the map's copy, which lives as long as the map's arena.
+// Complexity: O(1) expected
+char *MapSet(Map m, char *key, int value);
+
+// Removes the given key from the map. Returns true if it was there. The
+// map's copy of the key stays valid until the arena is freed.
+// Complexity: O(1) expected
+bool MapRemove(Map m, char *key);
 
 // Checks if the map contains the given key
-// Complexity: Assume O(log n) (even though it isn't)
+// Complexity: O(1) expected
 bool MapContains(Map m, char *key);
 
+// Looks up a key given as the first len characters of key, which need
+// not be null-terminated. If the key exists, stores its value in *value
+// and returns true, otherwise returns false.
+// Complexity: O(1) expected
+bool MapFind(Map m, const char *key, size_t len, int *value);
+
 // Gets  the  value associated with the given key. The key is assumed to
 // exist.
-// Complexity: Assume O(log n) (even though it isn't)
+// Complexity: O(1) expected
 int MapGet(Map m, char *key);
 
 #endif
@@ -0,0 +1,51 @@
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fatal.h"
+
+// the innermost trap of each thread
+static _Thread_local struct fatalTrap *currentTrap = NULL;
+
+////////////////////////////////////////////////////////////////////////
+
+void fatalError(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	struct fatalTrap *trap = currentTrap;
+	if (trap == NULL)
+	{
+		fprintf(stderr, "error: ");
+		vfprintf(stderr, format, args);
+		fprintf(stderr, "\n");
+		va_end(args);
+		exit(EXIT_FAILURE);
+	}
+	vsnprintf(trap->message, sizeof(trap->message), format, args);
+	va_end(args);
+	currentTrap = trap->outer;
+	longjmp(trap->env, 1);
+}
+
+void *fatalAllocate(size_t size)
+{
+	void *p = malloc(size);
+	if (p == NULL)
+	{
+		fatalError("out of memory");
+	}
+	return p;
+}
+
+void fatalSetTrap(struct fatalTrap *trap)
+{
+	trap->outer = currentTrap;
+	currentTrap = trap;
+}
+
+void fatalClearTrap(struct fatalTrap *trap)
+{
+	currentTrap = trap->outer;
+}
@@ -0,0 +1,39 @@
+#ifndef FATAL_H
+#define FATAL_H
+
+#include <setjmp.h>
+#include <stddef.h>
+
+#define FATAL_MESSAGE_SIZE 256
+
+// Errors a function cannot recover from, such as running out of memory or
+// failing to create a thread. By default fatalError prints the message
+// and ends the process. A thread can set a trap to get the message back
+// instead: fatalError then jumps to the trap, as longjmp does, so that the
+// function that set it can give up and report the error. Memory and files
+// held by the functions it jumps out of are not freed.
+struct fatalTrap
+{
+	jmp_buf env;					  // where fatalError jumps to
+	char message[FATAL_MESSAGE_SIZE]; // the message of the error
+	struct fatalTrap *outer;		  // the trap set before this one
+};
+
+// Reports an error described as by printf. Prints "error: " and the
+// message and exits, or if the calling thread has set a trap, removes the
+// trap, stores the message in it and jumps to it.
+_Noreturn void fatalError(const char *format, ...);
+
+// Allocates size bytes with malloc. Running out of memory is a fatal
+// error.
+void *fatalAllocate(size_t size);
+
+// Makes fatalError jump to trap on the calling thread, until the trap is
+// cleared or jumped to. setjmp(trap->env) must have been called by a
+// function that is still running. Traps can be nested.
+void fatalSetTrap(struct fatalTrap *trap);
+
+// Removes trap, the last trap set by the calling thread.
+void fatalClearTrap(struct fatalTrap *trap);
+
+#endif
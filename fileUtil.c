@@ -0,0 +1,117 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fileUtil.h"
+
+static void setStamp(struct stat *st, struct fileStamp *s);
+static bool isSpace(char c);
+
+////////////////////////////////////////////////////////////////////////
+
+bool stampFile(const char *path, struct fileStamp *s)
+{
+	struct stat st;
+	if (stat(path, &st) < 0)
+	{
+		return false;
+	}
+	setStamp(&st, s);
+	return true;
+}
+
+bool mapFile(const char *path, struct mappedFile *f)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st) < 0)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return false;
+	}
+
+	f->size = st.st_size;
+	setStamp(&st, &f->stamp);
+	f->data = NULL;
+	if (f->size > 0)
+	{
+		void *data = mmap(NULL, f->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			close(fd);
+			return false;
+		}
+		madvise(data, f->size, MADV_SEQUENTIAL);
+		f->data = data;
+	}
+	close(fd);
+	return true;
+}
+
+void unmapFile(struct mappedFile *f)
+{
+	if (f->data != NULL)
+	{
+		munmap((void *)f->data, f->size);
+	}
+}
+
+bool nextToken(const char **pos, const char *end, struct token *t)
+{
+	const char *p = *pos;
+	while (p < end && isSpace(*p))
+	{
+		p++;
+	}
+	if (p == end)
+	{
+		*pos = p;
+		return false;
+	}
+	const char *start = p;
+	while (p < end && !isSpace(*p))
+	{
+		p++;
+	}
+	t->s = start;
+	t->len = p - start;
+	*pos = p;
+	return true;
+}
+
+bool tokenIs(const struct token *t, const char *s)
+{
+	return strncmp(t->s, s, t->len) == 0 && s[t->len] == '\0';
+}
+
+bool sectionFits(int64_t fileSize, size_t headerSize, int64_t at,
+				 int64_t count, size_t size)
+{
+	return at >= (int64_t)headerSize && at % 8 == 0 && count >= 0 &&
+		   count <= (fileSize - at) / (int64_t)size;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Copies the size and modification time of a file from st to *s.
+static void setStamp(struct stat *st, struct fileStamp *s)
+{
+	s->size = st->st_size;
+	s->mtimeSec = st->st_mtim.tv_sec;
+	s->mtimeNsec = st->st_mtim.tv_nsec;
+}
+
+// Whitespace as accepted by scanf's %s conversion.
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+		   c == '\f';
+}
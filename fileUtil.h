@@ -0,0 +1,62 @@
+#ifndef FILE_UTIL_H
+#define FILE_UTIL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Helpers for the modules that read text files in place and write binary
+// files of their own: the snapshot, the loader and the search index.
+
+// The size and modification time of a file, recorded in a binary file to
+// tell whether the files it was built from have changed since. Part of the
+// snapshot and index formats.
+struct fileStamp
+{
+	int64_t size;
+	int64_t mtimeSec;
+	int64_t mtimeNsec;
+};
+
+// A file mapped into memory, with its stamp as it was mapped. Empty files
+// have a NULL data pointer.
+struct mappedFile
+{
+	const char *data;
+	size_t size;
+	struct fileStamp stamp;
+};
+
+// A token of a mapped file: a maximal run of non-space characters.
+struct token
+{
+	const char *s;
+	size_t len;
+};
+
+// Stores the size and modification time of the file at path in *s.
+// Returns false if there is no such file.
+bool stampFile(const char *path, struct fileStamp *s);
+
+// Maps the file at path into memory, to be read from start to end.
+// Returns false if the file cannot be opened or mapped.
+bool mapFile(const char *path, struct mappedFile *f);
+
+// Unmaps a file mapped by mapFile.
+void unmapFile(struct mappedFile *f);
+
+// Finds the next token at or after *pos and before end, and advances *pos
+// past it. Tokens are separated by whitespace, as for scanf's %s
+// conversion. Returns false if there are no more tokens.
+bool nextToken(const char **pos, const char *end, struct token *t);
+
+// Checks whether the token is the given null-terminated string.
+bool tokenIs(const struct token *t, const char *s);
+
+// Checks that count elements of the given size starting at offset at lie
+// within a binary file of fileSize bytes, after its header of headerSize
+// bytes, and that at is a multiple of 8.
+bool sectionFits(int64_t fileSize, size_t headerSize, int64_t at,
+				 int64_t count, size_t size);
+
+#endif
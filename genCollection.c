@@ -0,0 +1,540 @@
+// Generates a synthetic collection for benchmarking: collection.txt, one
+// urlN.txt page file per page with links in Section-1 and text in
+// Section-2, and the matching invertedIndex.txt.
+//
+// Two link models are supported:
+// powerlaw  out-degrees follow a power law with the given exponent, and
+//           links go to pages chosen with a skewed popularity, so the
+//           in-degrees follow a power law as well
+// rmat      links are placed by the recursive matrix model of Chakrabarti
+//           et al., which gives power-law degrees and community structure
+//
+// Words are drawn from a Zipf distribution over a fixed vocabulary.
+// The same arguments and seed always give the same collection.
+//
+// Usage: ./genCollection [-m powerlaw|rmat] [-d avgOutDegree]
+//                        [-a exponent] [-w wordsPerPage] [-s seed]
+//                        numPages directory
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DEFAULT_DEGREE 10.0
+#define DEFAULT_EXPONENT 2.5
+#define DEFAULT_WORDS 20
+#define DEFAULT_SEED 2521
+#define VOCABULARY_SIZE 5000
+#define POPULARITY_SKEW 3.0 // higher values concentrate links on fewer pages
+#define URLS_PER_LINE 10
+#define WORDS_PER_LINE 10
+#define MAXPATH 4096
+#define MAXWORD 16
+
+// The R-MAT probabilities of a link falling in each quadrant
+#define RMAT_A 0.57
+#define RMAT_B 0.19
+#define RMAT_C 0.19
+
+typedef enum
+{
+	MODEL_POWERLAW,
+	MODEL_RMAT,
+} linkModel;
+
+// A growable array of page ids.
+struct idList
+{
+	int *ids;
+	int size;
+	int capacity;
+};
+
+static uint64_t rngState;
+
+static void usage(char *progName);
+static double randomUnit(void);
+static int randomBelow(int n);
+static void makeLinks(linkModel model, int numPages, double degree,
+					  double exponent, int **offsets, int **links);
+static void powerLawLinks(int numPages, double degree, double exponent,
+						  int *offsets, struct idList *links);
+static void rmatLinks(int numPages, double degree, int *offsets,
+					  struct idList *links);
+static void makeVocabulary(char words[][MAXWORD], double *cumulative);
+static int randomWord(double *cumulative);
+static void writeCollection(const char *dir, int numPages);
+static void writePage(const char *dir, int page, int *links, int numLinks,
+					  int *pageWords, int numWords, char words[][MAXWORD]);
+static void writeInvertedIndex(const char *dir, int numPages,
+							   char words[][MAXWORD], struct idList *pages);
+static void append(struct idList *l, int id);
+static FILE *openFile(const char *dir, const char *name);
+static int compareNames(const void *a, const void *b);
+static void *allocate(size_t size);
+
+int main(int argc, char *argv[])
+{
+	linkModel model = MODEL_POWERLAW;
+	double degree = DEFAULT_DEGREE;
+	double exponent = DEFAULT_EXPONENT;
+	int wordsPerPage = DEFAULT_WORDS;
+	unsigned long seed = DEFAULT_SEED;
+	int opt;
+	while ((opt = getopt(argc, argv, "m:d:a:w:s:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'm':
+			if (strcmp(optarg, "powerlaw") == 0)
+			{
+				model = MODEL_POWERLAW;
+			}
+			else if (strcmp(optarg, "rmat") == 0)
+			{
+				model = MODEL_RMAT;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 'd':
+			degree = atof(optarg);
+			break;
+		case 'a':
+			exponent = atof(optarg);
+			break;
+		case 'w':
+			wordsPerPage = atoi(optarg);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (argc - optind != 2 || degree < 0 || exponent <= 2.0 ||
+		wordsPerPage < 0)
+	{
+		usage(argv[0]);
+	}
+	int numPages = atoi(argv[optind]);
+	const char *dir = argv[optind + 1];
+	if (numPages < 1)
+	{
+		usage(argv[0]);
+	}
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+	{
+		fprintf(stderr, "error: cannot create '%s'\n", dir);
+		return EXIT_FAILURE;
+	}
+	rngState = seed * 0x9E3779B97F4A7C15ull + 1;
+
+	int *offsets;
+	int *links;
+	makeLinks(model, numPages, degree, exponent, &offsets, &links);
+
+	static char words[VOCABULARY_SIZE][MAXWORD];
+	double *cumulative = allocate(VOCABULARY_SIZE * sizeof(double));
+	makeVocabulary(words, cumulative);
+	struct idList *pages = calloc(VOCABULARY_SIZE, sizeof(struct idList));
+	int *lastPage = allocate(VOCABULARY_SIZE * sizeof(int));
+	int *pageWords = allocate((wordsPerPage + 1) * sizeof(int));
+	if (pages == NULL)
+	{
+		fprintf(stderr, "error: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	for (int w = 0; w < VOCABULARY_SIZE; w++)
+	{
+		lastPage[w] = -1;
+	}
+
+	writeCollection(dir, numPages);
+	for (int p = 0; p < numPages; p++)
+	{
+		for (int k = 0; k < wordsPerPage; k++)
+		{
+			int w = randomWord(cumulative);
+			pageWords[k] = w;
+			if (lastPage[w] != p)
+			{
+				lastPage[w] = p;
+				append(&pages[w], p);
+			}
+		}
+		writePage(dir, p, &links[offsets[p]], offsets[p + 1] - offsets[p],
+				  pageWords, wordsPerPage, words);
+	}
+	writeInvertedIndex(dir, numPages, words, pages);
+	printf("%s: %d pages, %d links\n", dir, numPages, offsets[numPages]);
+
+	for (int w = 0; w < VOCABULARY_SIZE; w++)
+	{
+		free(pages[w].ids);
+	}
+	free(pages);
+	free(lastPage);
+	free(pageWords);
+	free(cumulative);
+	free(offsets);
+	free(links);
+	return EXIT_SUCCESS;
+}
+
+// Prints the usage message and exits.
+static void usage(char *progName)
+{
+	fprintf(stderr,
+			"Usage: %s [-m powerlaw|rmat] [-d avgOutDegree] [-a exponent] "
+			"[-w wordsPerPage] [-s seed] numPages directory\n"
+			"The exponent must be greater than 2.\n",
+			progName);
+	exit(EXIT_FAILURE);
+}
+
+// Returns a uniformly distributed number in [0, 1), using xorshift64*.
+static double randomUnit(void)
+{
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return ((rngState * 0x2545F4914F6CDD1Dull) >> 11) * 0x1.0p-53;
+}
+
+// Returns a uniformly distributed integer in [0, n).
+static int randomBelow(int n)
+{
+	return (int)(randomUnit() * n);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Links
+
+// Generates the links of every page. The links of page p are stored in
+// links[offsets[p]] to links[offsets[p + 1] - 1]. Like real pages, the
+// links may include self-links and duplicates.
+static void makeLinks(linkModel model, int numPages, double degree,
+					  double exponent, int **offsets, int **links)
+{
+	*offsets = allocate((numPages + 1) * sizeof(int));
+	struct idList l = {allocate(sizeof(int)), 0, 1};
+	if (model == MODEL_POWERLAW)
+	{
+		powerLawLinks(numPages, degree, exponent, *offsets, &l);
+	}
+	else
+	{
+		rmatLinks(numPages, degree, *offsets, &l);
+	}
+	*links = l.ids;
+}
+
+// Gives each page a Pareto distributed out-degree with the given mean and
+// exponent, and links it to pages chosen by popularity. Popularity ranks
+// are a random permutation of the pages, so popular pages are spread over
+// the whole collection.
+static void powerLawLinks(int numPages, double degree, double exponent,
+						  int *offsets, struct idList *links)
+{
+	int *byPopularity = allocate(numPages * sizeof(int));
+	for (int i = 0; i < numPages; i++)
+	{
+		byPopularity[i] = i;
+	}
+	for (int i = numPages - 1; i > 0; i--)
+	{
+		int j = randomBelow(i + 1);
+		int temp = byPopularity[i];
+		byPopularity[i] = byPopularity[j];
+		byPopularity[j] = temp;
+	}
+
+	// a Pareto distribution with this minimum has the given mean
+	double minDegree = degree * (exponent - 2.0) / (exponent - 1.0);
+	for (int p = 0; p < numPages; p++)
+	{
+		offsets[p] = links->size;
+		double d = minDegree * pow(1.0 - randomUnit(), -1.0 / (exponent - 1.0));
+		// round randomly, so the rounding does not change the mean
+		d = floor(d + randomUnit());
+		int numLinks = d > numPages - 1 ? numPages - 1 : (int)d;
+		for (int k = 0; k < numLinks; k++)
+		{
+			double rank = pow(randomUnit(), POPULARITY_SKEW) * numPages;
+			append(links, byPopularity[(int)rank]);
+		}
+	}
+	offsets[numPages] = links->size;
+	free(byPopularity);
+}
+
+// Places numPages * degree links with the R-MAT model on the smallest
+// power of two at least numPages, skipping links that fall outside the
+// collection, then groups them by source page.
+static void rmatLinks(int numPages, double degree, int *offsets,
+					  struct idList *links)
+{
+	int scale = 0;
+	while ((1L << scale) < numPages)
+	{
+		scale++;
+	}
+	long numLinks = (long)(numPages * degree);
+	int *src = allocate((numLinks + 1) * sizeof(int));
+	int *dst = allocate((numLinks + 1) * sizeof(int));
+	for (long e = 0; e < numLinks; e++)
+	{
+		int s;
+		int d;
+		do
+		{
+			s = 0;
+			d = 0;
+			for (int bit = 0; bit < scale; bit++)
+			{
+				double r = randomUnit();
+				if (r >= RMAT_A + RMAT_B + RMAT_C)
+				{
+					s |= 1 << bit;
+					d |= 1 << bit;
+				}
+				else if (r >= RMAT_A + RMAT_B)
+				{
+					s |= 1 << bit;
+				}
+				else if (r >= RMAT_A)
+				{
+					d |= 1 << bit;
+				}
+			}
+		} while (s >= numPages || d >= numPages);
+		src[e] = s;
+		dst[e] = d;
+	}
+
+	// counting sort by source
+	memset(offsets, 0, (numPages + 1) * sizeof(int));
+	for (long e = 0; e < numLinks; e++)
+	{
+		offsets[src[e] + 1]++;
+	}
+	for (int p = 0; p < numPages; p++)
+	{
+		offsets[p + 1] += offsets[p];
+	}
+	free(links->ids);
+	links->ids = allocate((numLinks + 1) * sizeof(int));
+	links->size = numLinks;
+	links->capacity = numLinks + 1;
+	int *next = allocate((numPages + 1) * sizeof(int));
+	memcpy(next, offsets, (numPages + 1) * sizeof(int));
+	for (long e = 0; e < numLinks; e++)
+	{
+		links->ids[next[src[e]]++] = dst[e];
+	}
+	free(next);
+	free(src);
+	free(dst);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Words
+
+// Builds the vocabulary out of syllables, and the cumulative Zipf
+// distribution of the words, where word i has weight 1 / (i + 1).
+static void makeVocabulary(char words[][MAXWORD], double *cumulative)
+{
+	static const char *syllables[] = {
+		"ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo", "be", "da",
+		"fu", "go", "hi", "ja", "pe", "zu", "ar", "el", "on", "is",
+	};
+	int numSyllables = sizeof(syllables) / sizeof(syllables[0]);
+
+	double total = 0.0;
+	for (int i = 0; i < VOCABULARY_SIZE; i++)
+	{
+		// spell i in base numSyllables, with at least two syllables
+		words[i][0] = '\0';
+		int n = i;
+		int length = 0;
+		do
+		{
+			strcat(words[i], syllables[n % numSyllables]);
+			n /= numSyllables;
+			length++;
+		} while (n > 0 || length < 2);
+		total += 1.0 / (i + 1);
+		cumulative[i] = total;
+	}
+	for (int i = 0; i < VOCABULARY_SIZE; i++)
+	{
+		cumulative[i] /= total;
+	}
+}
+
+// Returns a word drawn from the cumulative distribution.
+static int randomWord(double *cumulative)
+{
+	double r = randomUnit();
+	int lo = 0;
+	int hi = VOCABULARY_SIZE - 1;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (cumulative[mid] > r)
+		{
+			hi = mid;
+		}
+		else
+		{
+			lo = mid + 1;
+		}
+	}
+	return lo;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Output
+
+// Writes collection.txt, listing the pages a few to a line.
+static void writeCollection(const char *dir, int numPages)
+{
+	FILE *f = openFile(dir, "collection.txt");
+	for (int p = 0; p < numPages; p++)
+	{
+		bool endOfLine = p % URLS_PER_LINE == URLS_PER_LINE - 1 ||
+						 p == numPages - 1;
+		fprintf(f, "url%d%c", p, endOfLine ? '\n' : ' ');
+	}
+	fclose(f);
+}
+
+// Writes the page file of a page, with its links in Section-1 and its
+// words in Section-2.
+static void writePage(const char *dir, int page, int *links, int numLinks,
+					  int *pageWords, int numWords, char words[][MAXWORD])
+{
+	char name[MAXWORD + 8];
+	snprintf(name, sizeof(name), "url%d.txt", page);
+	FILE *f = openFile(dir, name);
+	fprintf(f, "#start Section-1\n\n");
+	for (int k = 0; k < numLinks; k++)
+	{
+		bool endOfLine = k % URLS_PER_LINE == URLS_PER_LINE - 1 ||
+						 k == numLinks - 1;
+		fprintf(f, "url%d%c", links[k], endOfLine ? '\n' : ' ');
+	}
+	fprintf(f, "\n#end Section-1\n\n#start Section-2\n");
+	for (int k = 0; k < numWords; k++)
+	{
+		bool endOfLine = k % WORDS_PER_LINE == WORDS_PER_LINE - 1 ||
+						 k == numWords - 1;
+		fprintf(f, "%s%c", words[pageWords[k]], endOfLine ? '\n' : ' ');
+	}
+	fprintf(f, "#end Section-2\n");
+	fclose(f);
+}
+
+// The names compareNames orders ids by.
+static char (*sortNames)[MAXWORD];
+
+// Writes invertedIndex.txt, listing the pages containing each word in
+// alphabetical order, for the words in alphabetical order.
+static void writeInvertedIndex(const char *dir, int numPages,
+							   char words[][MAXWORD], struct idList *pages)
+{
+	char(*pageNames)[MAXWORD] = allocate((size_t)numPages * MAXWORD);
+	for (int p = 0; p < numPages; p++)
+	{
+		snprintf(pageNames[p], MAXWORD, "url%d", p);
+	}
+	int *byWord = allocate(VOCABULARY_SIZE * sizeof(int));
+	for (int w = 0; w < VOCABULARY_SIZE; w++)
+	{
+		byWord[w] = w;
+	}
+	sortNames = words;
+	qsort(byWord, VOCABULARY_SIZE, sizeof(int), compareNames);
+
+	sortNames = pageNames;
+	FILE *f = openFile(dir, "invertedIndex.txt");
+	for (int k = 0; k < VOCABULARY_SIZE; k++)
+	{
+		struct idList *l = &pages[byWord[k]];
+		if (l->size == 0)
+		{
+			continue;
+		}
+		qsort(l->ids, l->size, sizeof(int), compareNames);
+		fprintf(f, "%s ", words[byWord[k]]);
+		for (int i = 0; i < l->size; i++)
+		{
+			fprintf(f, " %s", pageNames[l->ids[i]]);
+		}
+		fprintf(f, "\n");
+	}
+	fclose(f);
+	free(byWord);
+	free(pageNames);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Appends an id to a list, growing it when it is full.
+static void append(struct idList *l, int id)
+{
+	if (l->size == l->capacity)
+	{
+		l->capacity = l->capacity == 0 ? 16 : l->capacity * 2;
+		l->ids = realloc(l->ids, l->capacity * sizeof(int));
+		if (l->ids == NULL)
+		{
+			fprintf(stderr, "error: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	l->ids[l->size++] = id;
+}
+
+// Opens a file in the given directory for writing.
+static FILE *openFile(const char *dir, const char *name)
+{
+	char path[MAXPATH];
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	FILE *f = fopen(path, "w");
+	if (f == NULL)
+	{
+		fprintf(stderr, "error: cannot write '%s'\n", path);
+		exit(EXIT_FAILURE);
+	}
+	return f;
+}
+
+// Compares two ids by the names stored for them in sortNames.
+static int compareNames(const void *a, const void *b)
+{
+	return strcmp(sortNames[*(const int *)a], sortNames[*(const int *)b]);
+}
+
+// Allocates memory, exiting if there is none left.
+static void *allocate(size_t size)
+{
+	void *p = malloc(size > 0 ? size : 1);
+	if (p == NULL)
+	{
+		fprintf(stderr, "error: out of memory\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
@@ -1,41 +1,68 @@
 #include <assert.h>
+#include <float.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
+#include "Arena.h"
 #include "Map.h"
+#include "fatal.h"
 #include "graph.h"
+#include "graphPrivate.h"
+#include "outOfCore.h"
+#include "rankKernel.h"
+#include "reorder.h"
+#include "stats.h"
 
 #define DEFAULT_CAPACITY 1
+#define EXTRAPOLATION_PERIOD 10 // iterations between extrapolations
+// differences below this fraction of the total weight are rounding noise in
+// single precision, so the single precision iterations stop there
+#define FLOAT_NOISE (16 * FLT_EPSILON)
+// the mixed precision mode switches to double precision once the difference
+// is below this multiple of minDiff, leaving a few sweeps to refine it
+#define MIXED_SWITCH 4
 
-typedef struct adjNode *AdjList;
-struct adjNode
+struct rankJob
 {
-	int v;
-	AdjList next;
+	pageRank pg;
+	double damping;		 // the damping factor of the calculation
+	double constant;	 // (1 - damping) / numPages
+	double minDiff;		 // the difference at which the calculation stops
+	int maxIt;			 // the maximum number of iterations
+	int numIt;			 // the number of iterations done so far
+	bool done;			 // whether the workers should stop iterating
+	bool useFloat;		 // whether to iterate on the single precision weights
+	bool extrapolate;	 // whether to apply quadratic extrapolation
+	bool extrapolated;	 // whether the coefficients below could be found
+	double beta[3];		 // the extrapolation coefficients
+	double floatMinDiff; // minDiff as last raised in single precision
+	int numWorkers;		 // the number of workers sharing the calculation
+	struct rankWorker *workers;
+	pthread_barrier_t barrier;
 };
-typedef struct urlnode *urlNode;
 
-struct urlnode
+struct rankWorker
 {
-	int outDegree;	  // the number of outlinks from the node
-	int inDegree;	  // the number of links going into the node
-	double weight;	  // the current weight of the node
-	double oldWeight; // the weight of the node from the previous iteration
-	double wIn;		  // the Op value in the Win formula
-	double wOut;	  // the Op value in the Wout formula
-	AdjList list;	  // the list of nodes that are outbound links from this node
+	struct rankJob *job;
+	int start;		// the first page updated by this worker
+	int end;		// one past the last page updated by this worker
+	double diff;	// the weight difference of this worker's pages
+	double total;	// the total single precision weight of its pages
+	double dots[5];	// dot products of this worker's part of the iterates
 };
 
-struct pagerank
+// A thread of pgRunWorkers, held back until all of them have been started.
+struct workerStart
 {
-	int numPages; // number of pages in the graph
-	int capacity; // the total capacity of pages
-	char **urls;  // the id of a person is simply the index
-	Map urlToId;  // maps names to ids
-	urlNode *url; // adjacency lists, kept in increasing order
+	pthread_mutex_t *gate; // held until every thread has been started
+	bool *started;		   // whether every thread could be started
+	void *(*run)(void *);
+	void *worker;
 };
 
 struct orderUrl
@@ -46,69 +73,172 @@ struct orderUrl
 };
 
 static void increaseCapacity(pageRank pg);
-static char *myStrdup(char *s);
+static void *growArray(void *array, int oldSize, int newSize, size_t size);
 static int urlToId(pageRank pg, char *url);
+static void buildUrlMap(pageRank pg);
+static void detachSnapshot(pageRank pg);
+static void buildLists(pageRank pg);
+static void markDirty(pageRank pg, int id);
+static void removeDirty(pageRank pg, int id, int last);
+static double wInOf(pageRank pg, int i);
+static double wOutOf(pageRank pg, int i);
+static void removeLinksTo(pageRank pg, int id, int last);
+static void countingOffsets(const int *keys, int n, int *count,
+							int numKeys);
+static void relabelPages(pageRank pg, const int *order);
+static void permuteArray(void *array, const int *order, int n, size_t size);
+static void buildInLinks(pageRank pg);
+static void buildInCoefficients(pageRank pg);
+static int rankInMemory(pageRank pg, double damping, double minDiff,
+						int maxIt);
+static void *startWorker(void *arg);
+static void *rankWorkerRun(void *arg);
+static int powerIterate(struct rankJob *job);
+static int gaussSeidel(struct rankJob *job);
+static int floatIterate(struct rankJob *job);
+static void buildFloatCoefficients(pageRank pg);
+static void extrapolationDots(pageRank pg, struct rankWorker *w);
+static bool extrapolationCoefficients(struct rankJob *job);
+static void reserveWeights(pageRank pg, int numKeep);
+static double *newWeightArray(int n);
+static float *newFloatArray(int n);
 
-static AdjList adjListInsert(AdjList l, int v);
-static AdjList newAdjNode(int v);
+static AdjList adjListInsert(pageRank pg, AdjList l, int v);
+static AdjList newAdjNode(pageRank pg, int v);
 static bool inAdjList(AdjList l, int v);
-static void freeAdjList(AdjList l);
-static void sortByName(pageRank pg, struct orderUrl *orderUrl);
-static void sortByWeight(pageRank pg, struct orderUrl *orderUrl);
+static void freeAdjList(pageRank pg, AdjList l);
+static int compareOrderUrls(const void *a, const void *b);
+static struct orderUrl *sortTopUrls(pageRank pg, int *k);
+static void selectTopUrls(pageRank pg, struct orderUrl *orderUrl, int k);
+static void siftDown(struct orderUrl *heap, int size, int i);
 void printWeights(pageRank pg);
 
 pageRank pageRankNew(void)
 {
-	pageRank pg = malloc(sizeof(*pg));
+	pageRank pg = calloc(1, sizeof(*pg));
 	if (pg == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
 
 	pg->numPages = 0;
-	pg->capacity = DEFAULT_CAPACITY;
+	pg->capacity = 0;
+	increaseCapacity(pg);
+	pg->arena = ArenaNew();
+	pg->freeNodes = NULL;
+	pg->urlToId = MapNewInArena(pg->arena);
+	pg->listsValid = true;
+	pg->outLinksValid = false;
+	pg->inLinksValid = false;
+	pg->inCoeffValid = false;
+	pg->numThreads = 1;
+	pg->numWeights = 0;
+	pg->solver = PG_JACOBI;
+	pg->precision = PG_DOUBLE;
+	pg->floatMinDiff = 0.0;
+	pg->numFloatWeights = 0;
+	pg->inCoeffFValid = false;
+	pg->wInValid = false;
+	pg->wOutValid = false;
+	pg->numDirty = 0;
+	pg->dirtyCapacity = 0;
+	pg->warmStart = false;
+	pg->numRanked = 0;
+	pg->memoryCap = 0;
+	pg->snapshot = NULL;
+	return pg;
+}
 
-	pg->url = calloc(pg->capacity, sizeof(struct urlnode));
-	if (pg->url == NULL)
-	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
-	}
-	pg->urls = calloc(pg->capacity, sizeof(char *));
-	if (pg->urls == NULL)
+pageRank pgNewMapped(void *snapshot, size_t snapshotSize, int numPages,
+					 char **urls, int *outDegree, int *inDegree,
+					 int *outOffsets, int *outLinks)
+{
+	pageRank pg = calloc(1, sizeof(*pg));
+	if (pg == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
-	pg->urlToId = MapNew();
+
+	pg->numPages = numPages;
+	pg->capacity = numPages;
+	pg->arena = ArenaNew();
+	pg->freeNodes = NULL;
+	pg->urls = urls;
+	pg->urlToId = NULL;
+	pg->lists = NULL;
+	pg->listsValid = false;
+	pg->outDegree = outDegree;
+	pg->inDegree = inDegree;
+	pg->wIn = growArray(NULL, 0, numPages, sizeof(double));
+	pg->wOut = growArray(NULL, 0, numPages, sizeof(double));
+	pg->outOffsets = outOffsets;
+	pg->outLinks = outLinks;
+	pg->outLinksValid = true;
+	pg->inLinksValid = false;
+	pg->inCoeffValid = false;
+	pg->numThreads = 1;
+	pg->numWeights = 0;
+	pg->solver = PG_JACOBI;
+	pg->precision = PG_DOUBLE;
+	pg->floatMinDiff = 0.0;
+	pg->numFloatWeights = 0;
+	pg->inCoeffFValid = false;
+	pg->wInValid = false;
+	pg->wOutValid = false;
+	pg->numDirty = 0;
+	pg->dirtyCapacity = 0;
+	pg->warmStart = false;
+	pg->numRanked = 0;
+	pg->memoryCap = 0;
+	pg->snapshot = snapshot;
+	pg->snapshotSize = snapshotSize;
 	return pg;
 }
 
 void pgFree(pageRank pg)
 {
-	for (int i = 0; i < pg->numPages; i++)
+	// the URL strings and adjacency nodes all live in the arena
+	free(pg->lists);
+	if (pg->urlToId != NULL)
 	{
-		freeAdjList(pg->url[i]->list);
+		MapFree(pg->urlToId);
 	}
-	for (int j = 0; j < pg->capacity; j++)
+	ArenaFree(pg->arena);
+
+	if (pg->snapshot != NULL)
 	{
-		free(pg->url[j]);
+		// the strings, degrees and out-links live in the mapping
+		munmap(pg->snapshot, pg->snapshotSize);
 	}
-	free(pg->url);
-	MapFree(pg->urlToId);
-
-	for (int i = 0; i < pg->numPages; i++)
+	else
 	{
-		free(pg->urls[i]);
+		free(pg->outDegree);
+		free(pg->inDegree);
+		free(pg->outOffsets);
+		free(pg->outLinks);
 	}
 	free(pg->urls);
+	free(pg->wIn);
+	free(pg->wOut);
+	free(pg->inOffsets);
+	free(pg->inLinks);
+	free(pg->inCoeff);
+	free(pg->weights);
+	free(pg->oldWeights);
+	free(pg->histWeights[0]);
+	free(pg->histWeights[1]);
+	free(pg->weightsF);
+	free(pg->oldWeightsF);
+	free(pg->inCoeffF);
+	free(pg->dirty);
+	free(pg->dirtyPages);
 
 	free(pg);
 }
 
 bool pgAddLink(pageRank pg, char *name)
 {
+	detachSnapshot(pg);
 	if (pg->numPages == pg->capacity)
 	{
 		increaseCapacity(pg);
@@ -117,14 +247,22 @@ bool pgAddLink(pageRank pg, char *name)
 	if (!MapContains(pg->urlToId, name))
 	{
 		int id = pg->numPages++;
-		pg->urls[id] = myStrdup(name);
-		MapSet(pg->urlToId, name, id);
-		pg->url[id] = malloc(sizeof(struct urlnode));
-		pg->url[id]->list = NULL;
-		pg->url[id]->outDegree = 0.0;
-		pg->url[id]->inDegree = 0.0;
-		pg->url[id]->wIn = 0.0;
-		pg->url[id]->wOut = 0.0;
+		pg->urls[id] = MapSet(pg->urlToId, name, id);
+		pg->lists[id] = NULL;
+		pg->outDegree[id] = 0;
+		pg->inDegree[id] = 0;
+		pg->wIn[id] = 0.0;
+		pg->wOut[id] = 0.0;
+		if (pg->outLinksValid)
+		{
+			// the new page has no out-links, so the lists and the compressed
+			// copy both stay up to date
+			pg->outOffsets = growArray(pg->outOffsets, id + 1, id + 2,
+									   sizeof(int));
+			pg->outOffsets[id + 1] = pg->outOffsets[id];
+		}
+		pg->inLinksValid = false;
+		pg->inCoeffValid = false;
 		return true;
 	}
 	else
@@ -134,47 +272,62 @@ bool pgAddLink(pageRank pg, char *name)
 }
 static void increaseCapacity(pageRank pg)
 {
-	int newCapacity = pg->capacity * 2;
+	int newCapacity = pg->capacity == 0 ? DEFAULT_CAPACITY : pg->capacity * 2;
 
-	pg->urls = realloc(pg->urls, newCapacity * sizeof(char *));
-	if (pg->urls == NULL)
-	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
-	}
-	for (int i = pg->capacity; i < newCapacity; i++)
-	{
-		pg->urls[i] = NULL;
-	}
+	int oldCap = pg->capacity;
+	pg->urls = growArray(pg->urls, oldCap, newCapacity, sizeof(char *));
+	pg->lists = growArray(pg->lists, oldCap, newCapacity, sizeof(AdjList));
+	pg->outDegree = growArray(pg->outDegree, oldCap, newCapacity, sizeof(int));
+	pg->inDegree = growArray(pg->inDegree, oldCap, newCapacity, sizeof(int));
+	pg->wIn = growArray(pg->wIn, oldCap, newCapacity, sizeof(double));
+	pg->wOut = growArray(pg->wOut, oldCap, newCapacity, sizeof(double));
+
+	pg->capacity = newCapacity;
+}
 
-	pg->url = realloc(pg->url, newCapacity * sizeof(AdjList));
-	if (pg->url == NULL)
+// Resizes an array of oldSize elements to newSize elements, zeroing the
+// new elements.
+static void *growArray(void *array, int oldSize, int newSize, size_t size)
+{
+	char *grown = realloc(array, (newSize > 0 ? newSize : 1) * size);
+	if (grown == NULL)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("out of memory");
 	}
-	for (int i = pg->capacity; i < newCapacity; i++)
+	if (newSize > oldSize)
 	{
-		pg->url[i] = NULL;
+		memset(grown + oldSize * size, 0, (newSize - oldSize) * size);
 	}
-
-	pg->capacity = newCapacity;
+	return grown;
 }
 
 bool pgLink(pageRank pg, char *url1, char *url2)
 {
-	int id1 = urlToId(pg, url1);
-	int id2 = urlToId(pg, url2);
+	return pgLinkIds(pg, urlToId(pg, url1), urlToId(pg, url2));
+}
+
+bool pgLinkIds(pageRank pg, int id1, int id2)
+{
 	if (id1 == id2)
 	{
 		return false;
 	}
+	detachSnapshot(pg);
+	if (!pg->listsValid)
+	{
+		buildLists(pg);
+	}
 
-	if (!inAdjList(pg->url[id1]->list, id2))
+	if (!inAdjList(pg->lists[id1], id2))
 	{
-		pg->url[id1]->list = adjListInsert(pg->url[id1]->list, id2);
-		pg->url[id1]->outDegree++;
-		pg->url[id2]->inDegree++;
+		pg->lists[id1] = adjListInsert(pg, pg->lists[id1], id2);
+		pg->outDegree[id1]++;
+		pg->inDegree[id2]++;
+		markDirty(pg, id1);
+		markDirty(pg, id2);
+		pg->outLinksValid = false;
+		pg->inLinksValid = false;
+		pg->inCoeffValid = false;
 		return true;
 	}
 	else
@@ -183,11 +336,247 @@ bool pgLink(pageRank pg, char *url1, char *url2)
 	}
 }
 
+int pgLinkMany(pageRank pg, const int *src, const int *dst, int numLinks)
+{
+	detachSnapshot(pg);
+	pgCompileOutLinks(pg);
+
+	// gather the existing links and the new ones, minus self-links
+	int numOld = pg->outOffsets[pg->numPages];
+	int n = numOld;
+	int *edgeSrc = malloc(((size_t)numOld + numLinks + 1) * sizeof(int));
+	int *edgeDst = malloc(((size_t)numOld + numLinks + 1) * sizeof(int));
+	int *count = malloc((pg->numPages + 1) * sizeof(int));
+	if (edgeSrc == NULL || edgeDst == NULL || count == NULL)
+	{
+		fatalError("out of memory");
+	}
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		for (int j = pg->outOffsets[i]; j < pg->outOffsets[i + 1]; j++)
+		{
+			edgeSrc[j] = i;
+		}
+	}
+	memcpy(edgeDst, pg->outLinks, numOld * sizeof(int));
+	for (int k = 0; k < numLinks; k++)
+	{
+		if (src[k] != dst[k])
+		{
+			edgeSrc[n] = src[k];
+			edgeDst[n] = dst[k];
+			n++;
+			markDirty(pg, src[k]);
+			markDirty(pg, dst[k]);
+		}
+	}
+
+	// least significant digit first radix sort with one digit per id:
+	// a counting sort by destination, then a stable one by source
+	int *byDstSrc = malloc(((size_t)n + 1) * sizeof(int));
+	int *byDst = malloc(((size_t)n + 1) * sizeof(int));
+	int *links = malloc(((size_t)n + 1) * sizeof(int));
+	if (byDstSrc == NULL || byDst == NULL || links == NULL)
+	{
+		fatalError("out of memory");
+	}
+	countingOffsets(edgeDst, n, count, pg->numPages);
+	for (int k = 0; k < n; k++)
+	{
+		int pos = count[edgeDst[k]]++;
+		byDstSrc[pos] = edgeSrc[k];
+		byDst[pos] = edgeDst[k];
+	}
+	countingOffsets(edgeSrc, n, count, pg->numPages);
+	for (int k = 0; k < n; k++)
+	{
+		links[count[byDstSrc[k]]++] = byDst[k];
+	}
+	free(edgeSrc);
+	free(edgeDst);
+	free(byDstSrc);
+	free(byDst);
+
+	// count[i] is now where page i's links end; drop the duplicates of
+	// each page's sorted links, compacting them in place
+	int *offsets = pg->outOffsets;
+	memset(pg->inDegree, 0, pg->numPages * sizeof(int));
+	int start = 0;
+	int m = 0;
+	offsets[0] = 0;
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		for (int k = start; k < count[i]; k++)
+		{
+			if (k == start || links[k] != links[k - 1])
+			{
+				links[m++] = links[k];
+				pg->inDegree[links[k]]++;
+			}
+		}
+		start = count[i];
+		offsets[i + 1] = m;
+		pg->outDegree[i] = m - offsets[i];
+	}
+	free(count);
+
+	free(pg->outLinks);
+	pg->outLinks = links;
+	pg->outLinksValid = true;
+	pg->listsValid = false;
+	pg->inLinksValid = false;
+	pg->inCoeffValid = false;
+	return m - numOld;
+}
+
+bool pgUnlink(pageRank pg, char *url1, char *url2)
+{
+	return pgUnlinkIds(pg, urlToId(pg, url1), urlToId(pg, url2));
+}
+
+bool pgUnlinkIds(pageRank pg, int id1, int id2)
+{
+	detachSnapshot(pg);
+	if (!pg->listsValid)
+	{
+		buildLists(pg);
+	}
+
+	AdjList *next = &pg->lists[id1];
+	while (*next != NULL && (*next)->v < id2)
+	{
+		next = &(*next)->next;
+	}
+	if (*next == NULL || (*next)->v != id2)
+	{
+		return false;
+	}
+	AdjList n = *next;
+	*next = n->next;
+	n->next = pg->freeNodes;
+	pg->freeNodes = n;
+	pg->outDegree[id1]--;
+	pg->inDegree[id2]--;
+	markDirty(pg, id1);
+	markDirty(pg, id2);
+	pg->outLinksValid = false;
+	pg->inLinksValid = false;
+	pg->inCoeffValid = false;
+	return true;
+}
+
+bool pgRemovePage(pageRank pg, char *name)
+{
+	detachSnapshot(pg);
+	int id = pgUrlId(pg, name, strlen(name));
+	if (id < 0)
+	{
+		return false;
+	}
+	pgCompileOutLinks(pg);
+
+	// the pages it links to lose an in-link
+	for (int j = pg->outOffsets[id]; j < pg->outOffsets[id + 1]; j++)
+	{
+		pg->inDegree[pg->outLinks[j]]--;
+		markDirty(pg, pg->outLinks[j]);
+	}
+
+	// move the last page into the removed page's id
+	int last = pg->numPages - 1;
+	removeLinksTo(pg, id, last);
+	removeDirty(pg, id, last);
+	MapRemove(pg->urlToId, pg->urls[id]);
+	if (id != last)
+	{
+		MapSet(pg->urlToId, pg->urls[last], id);
+		pg->urls[id] = pg->urls[last];
+		pg->outDegree[id] = pg->outDegree[last];
+		pg->inDegree[id] = pg->inDegree[last];
+		pg->wIn[id] = pg->wIn[last];
+		pg->wOut[id] = pg->wOut[last];
+	}
+	if (id != last && id < pg->numRanked)
+	{
+		// pages that were not ranked start at the usual initial weight
+		pg->oldWeights[id] = last < pg->numRanked ? pg->oldWeights[last]
+												  : 1.0 / last;
+	}
+	if (pg->numRanked > last)
+	{
+		pg->numRanked = last;
+	}
+	freeAdjList(pg, pg->lists[id]);
+	pg->lists[id] = pg->lists[last];
+	pg->lists[last] = NULL;
+	pg->numPages--;
+
+	pg->listsValid = false;
+	pg->inLinksValid = false;
+	pg->inCoeffValid = false;
+	return true;
+}
+
+void pgReorder(pageRank pg, pgOrdering ordering)
+{
+	if (ordering == PG_ORDER_NONE || pg->numPages < 2)
+	{
+		return;
+	}
+	detachSnapshot(pg);
+	pgCompileOutLinks(pg);
+	if (!pg->inLinksValid)
+	{
+		buildInLinks(pg);
+	}
+	int *order = growArray(NULL, 0, pg->numPages, sizeof(int));
+	switch (ordering)
+	{
+	case PG_ORDER_DEGREE:
+		orderByDegree(pg->outDegree, pg->numPages, order);
+		break;
+	case PG_ORDER_HUBS:
+		orderByHubs(pg->outOffsets, pg->outLinks, pg->inOffsets, pg->inLinks,
+					pg->numPages, order);
+		break;
+	default:
+		orderByRcm(pg->outOffsets, pg->outLinks, pg->inOffsets, pg->inLinks,
+				   pg->numPages, order);
+		break;
+	}
+	relabelPages(pg, order);
+	free(order);
+}
+
+int pgUrlId(pageRank pg, const char *url, size_t len)
+{
+	if (pg->urlToId == NULL)
+	{
+		buildUrlMap(pg);
+	}
+	int id;
+	statsCount(STAT_MAP_LOOKUPS, 1);
+	return MapFind(pg->urlToId, url, len, &id) ? id : -1;
+}
+
+int pgNumPages(pageRank pg)
+{
+	return pg->numPages;
+}
+
 bool pgIsLinked(pageRank pg, char *url1, char *url2)
 {
 	int id1 = urlToId(pg, url1);
 	int id2 = urlToId(pg, url2);
-	return inAdjList(pg->url[id1]->list, id2);
+	pgCompileOutLinks(pg);
+	for (int j = pg->outOffsets[id1]; j < pg->outOffsets[id1 + 1]; j++)
+	{
+		if (pg->outLinks[j] == id2)
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
 bool adjNodeIndex(AdjList L, int num)
@@ -205,99 +594,222 @@ bool adjNodeIndex(AdjList L, int num)
 
 List inAdjUrlNodes(pageRank pg, int node)
 {
+	if (!pg->inLinksValid)
+	{
+		buildInLinks(pg);
+	}
 	List l = ListNew();
+	for (int j = pg->inOffsets[node]; j < pg->inOffsets[node + 1]; j++)
+	{
+		ListAppend(l, pg->urls[pg->inLinks[j]]);
+	}
+	return l;
+}
+
+void pgCompileOutLinks(pageRank pg)
+{
+	if (pg->outLinksValid)
+	{
+		return;
+	}
+	int *outOffsets = malloc((pg->numPages + 1) * sizeof(int));
+	if (outOffsets == NULL)
+	{
+		fatalError("out of memory");
+	}
+	outOffsets[0] = 0;
 	for (int i = 0; i < pg->numPages; i++)
 	{
-		if (inAdjList(pg->url[i]->list, node))
+		outOffsets[i + 1] = outOffsets[i] + pg->outDegree[i];
+	}
+	int *outLinks = malloc((outOffsets[pg->numPages] + 1) * sizeof(int));
+	if (outLinks == NULL)
+	{
+		fatalError("out of memory");
+	}
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		int j = outOffsets[i];
+		for (AdjList curr = pg->lists[i]; curr != NULL; curr = curr->next)
 		{
-			ListAppend(l, pg->urls[i]);
+			outLinks[j++] = curr->v;
 		}
 	}
-	return l;
+	free(pg->outOffsets);
+	free(pg->outLinks);
+	pg->outOffsets = outOffsets;
+	pg->outLinks = outLinks;
+	pg->outLinksValid = true;
+}
+
+void pgCompileInCoefficients(pageRank pg)
+{
+	if (!pg->inCoeffValid)
+	{
+		buildInCoefficients(pg);
+	}
 }
 
 void wOutCalc(pageRank pg)
 {
+	pgCompileOutLinks(pg);
 	for (int i = 0; i < pg->numPages; i++)
 	{
-		double refPageSum = 0.0;
-		for (AdjList curr = pg->url[i]->list; curr != NULL; curr = curr->next)
-		{
-			int index = curr->v;
-			if (pg->url[index]->outDegree == 0)
-			{
-				refPageSum += 0.5;
-			}
-			else
-			{
-				refPageSum += pg->url[index]->outDegree;
-			}
-		}
-		pg->url[i]->wOut = refPageSum;
+		pg->wOut[i] = wOutOf(pg, i);
+	}
+	pg->wOutValid = true;
+	if (pg->wInValid)
+	{
+		removeDirty(pg, -1, -1);
 	}
+	pg->inCoeffValid = false;
 }
 void wInCalc(pageRank pg)
 {
+	pgCompileOutLinks(pg);
 	for (int i = 0; i < pg->numPages; i++)
 	{
-		double refPageSum = 0.0;
-		for (AdjList curr = pg->url[i]->list; curr != NULL; curr = curr->next)
-		{
-			int index = curr->v;
-			refPageSum += pg->url[index]->inDegree;
-		}
-		pg->url[i]->wIn = refPageSum;
+		pg->wIn[i] = wInOf(pg, i);
+	}
+	pg->wInValid = true;
+	if (pg->wOutValid)
+	{
+		removeDirty(pg, -1, -1);
 	}
+	pg->inCoeffValid = false;
 }
-void rankCalculator(pageRank pg, double damping, double minDiff, int maxIt)
+void pgUpdateW(pageRank pg)
 {
-	double currDiff = 9999999999.0;
-	double constant = (1.0 - damping) / pg->numPages;
-	for (int i = 0; i < pg->numPages; i++)
+	if (!pg->wInValid || !pg->wOutValid)
 	{
-		pg->url[i]->weight = 1.0 / pg->numPages;
-		pg->url[i]->oldWeight = 1.0 / pg->numPages;
+		wInCalc(pg);
+		wOutCalc(pg);
+		return;
 	}
-	for (int currIt = 0; currIt < maxIt && minDiff <= currDiff; currIt++)
+	if (pg->numDirty == 0)
 	{
-		for (int i = 0; i < pg->numPages; i++)
-		{
-			double currWeight = rawWeightingCalc(pg, i);
-			currWeight *= damping;
-			currWeight += constant;
-			pg->url[i]->weight = currWeight;
-		}
-		currDiff = diffPR(pg);
-		for (int j = 0; j < pg->numPages; j++)
+		return;
+	}
+	pgCompileOutLinks(pg);
+	if (!pg->inLinksValid)
+	{
+		buildInLinks(pg);
+	}
+
+	// the Win and Wout values of a page depend on its out-links and on the
+	// degrees of the pages it links to, so the pages linking to a dirty
+	// page are out of date as well
+	int numChanged = pg->numDirty;
+	for (int k = 0; k < numChanged; k++)
+	{
+		int i = pg->dirtyPages[k];
+		for (int j = pg->inOffsets[i]; j < pg->inOffsets[i + 1]; j++)
 		{
-			pg->url[j]->oldWeight = pg->url[j]->weight;
+			markDirty(pg, pg->inLinks[j]);
 		}
 	}
+	for (int k = 0; k < pg->numDirty; k++)
+	{
+		int i = pg->dirtyPages[k];
+		pg->wIn[i] = wInOf(pg, i);
+		pg->wOut[i] = wOutOf(pg, i);
+	}
+	removeDirty(pg, -1, -1);
+	pg->inCoeffValid = false;
+}
+void pgSetThreads(pageRank pg, int numThreads)
+{
+	pg->numThreads = numThreads < 1 ? 1 : numThreads;
+}
+
+void pgSetSolver(pageRank pg, pgSolver solver)
+{
+	pg->solver = solver;
+}
+
+void pgSetWarmStart(pageRank pg, bool warmStart)
+{
+	pg->warmStart = warmStart;
+}
+
+void pgSetPrecision(pageRank pg, pgPrecision precision)
+{
+	pg->precision = precision;
+}
+
+void pgSetMemoryCap(pageRank pg, size_t memoryCap)
+{
+	pg->memoryCap = memoryCap;
+}
+
+int rankCalculator(pageRank pg, double damping, double minDiff, int maxIt)
+{
+	// the out-of-core engine only does double precision Jacobi and
+	// Gauss-Seidel iterations
+	bool outOfCore = pg->memoryCap > 0 && pg->precision == PG_DOUBLE &&
+					 pg->solver != PG_EXTRAPOLATED &&
+					 inMemoryRankSize(pg) > pg->memoryCap;
+	if (!outOfCore && !pg->inCoeffValid)
+	{
+		buildInCoefficients(pg);
+	}
+	// a warm start begins from the weights of the last calculation, with
+	// the pages added since then at the usual initial weight
+	int numWarm = pg->warmStart ? pg->numRanked : 0;
+	reserveWeights(pg, numWarm);
+	for (int i = numWarm; i < pg->numPages; i++)
+	{
+		pg->oldWeights[i] = 1.0 / pg->numPages;
+	}
+	memcpy(pg->weights, pg->oldWeights, pg->numPages * sizeof(double));
+	pg->numRanked = pg->numPages;
+	pg->floatMinDiff = 0.0;
+	if (maxIt <= 0 || pg->numPages == 0)
+	{
+		return 0;
+	}
+
+	int numIt;
+	if (outOfCore)
+	{
+		numIt = outOfCoreRank(pg, damping, minDiff, maxIt);
+	}
+	else
+	{
+		numIt = rankInMemory(pg, damping, minDiff, maxIt);
+	}
+	pgCompileOutLinks(pg);
+	statsSet(STAT_PAGES, pg->numPages);
+	statsSet(STAT_LINKS, pg->outOffsets[pg->numPages]);
+	statsCount(STAT_ITERATIONS, numIt);
+	memcpy(pg->oldWeights, pg->weights, pg->numPages * sizeof(double));
+	return numIt;
+}
+
+void pgSetWeights(pageRank pg, const double *weights)
+{
+	reserveWeights(pg, 0);
+	memcpy(pg->weights, weights, pg->numPages * sizeof(double));
+	memcpy(pg->oldWeights, weights, pg->numPages * sizeof(double));
+	pg->numRanked = pg->numPages;
+}
+
+double pgFloatMinDiff(pageRank pg)
+{
+	return pg->floatMinDiff;
 }
 
 double rawWeightingCalc(pageRank pg, int index)
 {
-	List l = inAdjUrlNodes(pg, index);
+	if (!pg->inCoeffValid)
+	{
+		buildInCoefficients(pg);
+	}
 	double sum = 0.0;
-	ListIterator it = ListItNew(l);
-	double wOut;
-	while (ListItHasNext(it))
+	for (int j = pg->inOffsets[index]; j < pg->inOffsets[index + 1]; j++)
 	{
-		char *file = ListItNext(it);
-		int inIndex = urlToId(pg, file);
-		if (pg->url[index]->outDegree == 0)
-		{
-			wOut = 0.5 / pg->url[inIndex]->wOut;
-		}
-		else
-		{
-			wOut = pg->url[index]->outDegree / pg->url[inIndex]->wOut;
-		}
-		double wIn = pg->url[index]->inDegree / pg->url[inIndex]->wIn;
-		sum += pg->url[inIndex]->oldWeight * wOut * wIn;
+		sum += pg->oldWeights[pg->inLinks[j]] * pg->inCoeff[j];
 	}
-	ListFree(l);
-	ListItFree(it);
 	return sum;
 }
 
@@ -306,157 +818,1033 @@ double diffPR(pageRank pg)
 	double currDiff = 0.0;
 	for (int i = 0; i < pg->numPages; i++)
 	{
-		currDiff += fabs(pg->url[i]->weight - pg->url[i]->oldWeight);
+		currDiff += fabs(pg->weights[i] - pg->oldWeights[i]);
 	}
 	return currDiff;
 }
 
 void orderUrls(pageRank pg)
 {
-	struct orderUrl orderUrl[pg->numPages];
-	for (int i = 0; i < pg->numPages; i++)
+	orderUrlsTop(pg, pg->numPages);
+}
+
+void orderUrlsTop(pageRank pg, int k)
+{
+	struct orderUrl *orderUrl = sortTopUrls(pg, &k);
+	for (int i = 0; i < k; i++)
 	{
-		orderUrl[i].s = pg->urls[i];
-		orderUrl[i].weight = pg->url[i]->weight;
-		orderUrl[i].outDegree = pg->url[i]->outDegree;
+		printf("%s %d %.7lf\n", orderUrl[i].s, orderUrl[i].outDegree,
+			   orderUrl[i].weight);
 	}
-	sortByName(pg, orderUrl);
-	sortByWeight(pg, orderUrl);
-	for (int k = 0; k < pg->numPages; k++)
+	free(orderUrl);
+}
+
+int pgTopPages(pageRank pg, int k, const char **urls, int *outDegrees,
+			   double *weights)
+{
+	struct orderUrl *orderUrl = sortTopUrls(pg, &k);
+	for (int i = 0; i < k; i++)
 	{
-		printf("%s %d %.7lf\n", orderUrl[k].s, orderUrl[k].outDegree,
-			   orderUrl[k].weight);
+		urls[i] = orderUrl[i].s;
+		outDegrees[i] = orderUrl[i].outDegree;
+		weights[i] = orderUrl[i].weight;
 	}
+	free(orderUrl);
+	return k;
 }
 ////////////////////////////////////////////////////////////////////////
 // Helper Functions
 
-static char *myStrdup(char *s)
+// Converts a name to an ID. Raises an error if the name doesn't exist.
+static int urlToId(pageRank pg, char *name)
 {
-	char *copy = malloc((strlen(s) + 1) * sizeof(char));
-	if (copy == NULL)
+	int id = pgUrlId(pg, name, strlen(name));
+	if (id < 0)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		fatalError("url '%s' does not exist!", name);
 	}
-	return strcpy(copy, s);
+	return id;
 }
 
-// Converts a name to an ID. Raises an error if the name doesn't exist.
-static int urlToId(pageRank pg, char *name)
+// Builds the URL map of a graph read from a snapshot.
+static void buildUrlMap(pageRank pg)
 {
-	if (!MapContains(pg->urlToId, name))
+	pg->urlToId = MapNewInArena(pg->arena);
+	for (int i = 0; i < pg->numPages; i++)
 	{
-		fprintf(stderr, "error: url '%s' does not exist!\n", name);
-		exit(EXIT_FAILURE);
+		MapSet(pg->urlToId, pg->urls[i], i);
 	}
-	return MapGet(pg->urlToId, name);
 }
 
-// Inserts the given value into the adjacency list if it is not there already.
-static AdjList adjListInsert(AdjList l, int v)
+// Copies everything a graph keeps in its snapshot to the heap and unmaps
+// the snapshot, so that the graph can be modified. Does nothing if the
+// graph was not read from a snapshot.
+static void detachSnapshot(pageRank pg)
 {
-	if (l == NULL || v < l->v)
+	if (pg->snapshot == NULL)
 	{
-		AdjList new = newAdjNode(v);
-		new->next = l;
-		return new;
+		return;
 	}
-	else if (v == l->v)
+	if (pg->urlToId == NULL)
 	{
-		return l;
+		buildUrlMap(pg);
 	}
-	else
+	int capacity = pg->numPages > 0 ? pg->numPages : DEFAULT_CAPACITY;
+	int *outDegree = growArray(NULL, 0, capacity, sizeof(int));
+	int *inDegree = growArray(NULL, 0, capacity, sizeof(int));
+	memcpy(outDegree, pg->outDegree, pg->numPages * sizeof(int));
+	memcpy(inDegree, pg->inDegree, pg->numPages * sizeof(int));
+	for (int i = 0; i < pg->numPages; i++)
 	{
-		l->next = adjListInsert(l->next, v);
-		return l;
+		// point at the map's copy, which lives in the graph's arena
+		pg->urls[i] = MapSet(pg->urlToId, pg->urls[i], i);
 	}
+	pg->urls = growArray(pg->urls, pg->numPages, capacity, sizeof(char *));
+	pg->lists = growArray(NULL, 0, capacity, sizeof(AdjList));
+	pg->wIn = growArray(pg->wIn, pg->numPages, capacity, sizeof(double));
+	pg->wOut = growArray(pg->wOut, pg->numPages, capacity, sizeof(double));
+	buildLists(pg);
+
+	pg->outDegree = outDegree;
+	pg->inDegree = inDegree;
+	pg->outOffsets = NULL;
+	pg->outLinks = NULL;
+	pg->outLinksValid = false;
+	pg->capacity = capacity;
+	munmap(pg->snapshot, pg->snapshotSize);
+	pg->snapshot = NULL;
 }
 
-// Creates a new adjacency node.
-static AdjList newAdjNode(int v)
+// Rebuilds the adjacency lists from outOffsets and outLinks.
+static void buildLists(pageRank pg)
 {
-	AdjList n = malloc(sizeof(*n));
-	if (n == NULL)
+	for (int i = 0; i < pg->numPages; i++)
 	{
-		fprintf(stderr, "error: out of memory\n");
-		exit(EXIT_FAILURE);
+		freeAdjList(pg, pg->lists[i]);
+		AdjList *tail = &pg->lists[i];
+		for (int j = pg->outOffsets[i]; j < pg->outOffsets[i + 1]; j++)
+		{
+			*tail = newAdjNode(pg, pg->outLinks[j]);
+			tail = &(*tail)->next;
+		}
+		*tail = NULL;
 	}
-	n->v = v;
-	n->next = NULL;
-	return n;
+	pg->listsValid = true;
 }
 
-// Frees the given adjacency list.
-static void freeAdjList(AdjList l)
+// Adds a page to the pages whose Win and Wout values may be out of date.
+static void markDirty(pageRank pg, int id)
 {
-	AdjList n = l;
-	while (n != NULL)
+	if (pg->dirtyCapacity < pg->capacity)
 	{
-		AdjList temp = n;
-		n = n->next;
-		free(temp);
+		pg->dirty = growArray(pg->dirty, pg->dirtyCapacity, pg->capacity,
+							  sizeof(bool));
+		pg->dirtyPages = growArray(pg->dirtyPages, pg->dirtyCapacity,
+								   pg->capacity, sizeof(int));
+		pg->dirtyCapacity = pg->capacity;
+	}
+	if (!pg->dirty[id])
+	{
+		pg->dirty[id] = true;
+		pg->dirtyPages[pg->numDirty++] = id;
 	}
 }
 
-// Checks whether a node already exists in an adjacency list.
-// Returns true if it does exist, else it returns false.
-static bool inAdjList(AdjList l, int v)
+// Removes the given page from the dirty pages, renaming the page last to
+// id if it is dirty. With an id of -1, clears the dirty pages.
+static void removeDirty(pageRank pg, int id, int last)
 {
-	for (AdjList n = l; n != NULL && n->v <= v; n = n->next)
+	int n = 0;
+	for (int k = 0; k < pg->numDirty; k++)
 	{
-		if (n->v == v)
+		int i = pg->dirtyPages[k];
+		pg->dirty[i] = false;
+		if (id >= 0 && i != id)
 		{
-			return true;
+			pg->dirtyPages[n++] = i == last ? id : i;
 		}
 	}
-	return false;
+	pg->numDirty = n;
+	for (int k = 0; k < n; k++)
+	{
+		pg->dirty[pg->dirtyPages[k]] = true;
+	}
 }
 
-// Sorts the given pages by alphabetical order using a stable bubblesort.
-static void sortByName(pageRank pg, struct orderUrl *orderUrl)
+// Calculates the Op value in the Win formula of a page.
+static double wInOf(pageRank pg, int i)
 {
-	for (int i = 0; i < pg->numPages; i++)
+	double refPageSum = 0.0;
+	for (int j = pg->outOffsets[i]; j < pg->outOffsets[i + 1]; j++)
 	{
-		for (int j = 0; j < pg->numPages - 1; j++)
+		refPageSum += pg->inDegree[pg->outLinks[j]];
+	}
+	return refPageSum;
+}
+
+// Calculates the Op value in the Wout formula of a page.
+static double wOutOf(pageRank pg, int i)
+{
+	double refPageSum = 0.0;
+	for (int j = pg->outOffsets[i]; j < pg->outOffsets[i + 1]; j++)
+	{
+		int index = pg->outLinks[j];
+		if (pg->outDegree[index] == 0)
 		{
-			if (strcmp(orderUrl[j].s, orderUrl[j + 1].s) > 0)
-			{
-				double weightTemp = orderUrl[j].weight;
-				char *temp = orderUrl[j].s;
-				int outTemp = orderUrl[j].outDegree;
-				orderUrl[j].weight = orderUrl[j + 1].weight;
-				orderUrl[j].s = orderUrl[j + 1].s;
-				orderUrl[j].outDegree = orderUrl[j + 1].outDegree;
-				orderUrl[j + 1].weight = weightTemp;
-				orderUrl[j + 1].outDegree = outTemp;
-				orderUrl[j + 1].s = temp;
-			}
+			refPageSum += 0.5;
+		}
+		else
+		{
+			refPageSum += pg->outDegree[index];
 		}
 	}
+	return refPageSum;
 }
 
-// Sorts the given pages by decreasing weight order using a stable bubblesort.
-static void sortByWeight(pageRank pg, struct orderUrl *orderUrl)
+// Rewrites the out-links without page id, whose row and links are dropped,
+// and with page last renamed to id. Pages that linked to id lose an
+// out-link and become dirty. The number of pages is left to the caller.
+static void removeLinksTo(pageRank pg, int id, int last)
 {
-	for (int i = 0; i < pg->numPages; i++)
+	int *offsets = malloc(pg->numPages * sizeof(int));
+	int *links = malloc((pg->outOffsets[pg->numPages] + 1) * sizeof(int));
+	if (offsets == NULL || links == NULL)
+	{
+		fatalError("out of memory");
+	}
+
+	int m = 0;
+	offsets[0] = 0;
+	for (int k = 0; k < last; k++)
 	{
-		for (int j = 0; j < pg->numPages - 1; j++)
+		int i = k == id ? last : k;
+		int start = m;
+		for (int j = pg->outOffsets[i]; j < pg->outOffsets[i + 1]; j++)
 		{
-			if (orderUrl[j].weight < orderUrl[j + 1].weight)
+			int v = pg->outLinks[j];
+			if (v == id)
+			{
+				pg->outDegree[i]--;
+				markDirty(pg, i);
+			}
+			else if (v == last)
 			{
-				double weightTemp = orderUrl[j].weight;
-				char *temp = orderUrl[j].s;
-				int outTemp = orderUrl[j].outDegree;
-				orderUrl[j].weight = orderUrl[j + 1].weight;
-				orderUrl[j].s = orderUrl[j + 1].s;
-				orderUrl[j].outDegree = orderUrl[j + 1].outDegree;
-				orderUrl[j + 1].weight = weightTemp;
-				orderUrl[j + 1].outDegree = outTemp;
-				orderUrl[j + 1].s = temp;
+				// last is the biggest id, so it ends the row; move the new
+				// id to its place to keep the row in increasing order
+				int pos = m;
+				while (pos > start && links[pos - 1] > id)
+				{
+					links[pos] = links[pos - 1];
+					pos--;
+				}
+				links[pos] = id;
+				m++;
 			}
+			else
+			{
+				links[m++] = v;
+			}
+		}
+		offsets[k + 1] = m;
+	}
+	free(pg->outOffsets);
+	free(pg->outLinks);
+	pg->outOffsets = offsets;
+	pg->outLinks = links;
+	pg->outLinksValid = true;
+}
+
+// Sets count[key] to the position the first of the n keys equal to key
+// would take if the keys were sorted, for keys below numKeys.
+static void countingOffsets(const int *keys, int n, int *count, int numKeys)
+{
+	memset(count, 0, (numKeys + 1) * sizeof(int));
+	for (int k = 0; k < n; k++)
+	{
+		count[keys[k] + 1]++;
+	}
+	for (int i = 0; i < numKeys; i++)
+	{
+		count[i + 1] += count[i];
+	}
+}
+
+// Gives page order[i] the id i. The out-links are rebuilt from the in-link
+// index, visiting the destinations in their new order, so each page's
+// out-links come out sorted without sorting them. Warm start weights are
+// kept if every page has one.
+static void relabelPages(pageRank pg, const int *order)
+{
+	int n = pg->numPages;
+	int *newId = growArray(NULL, 0, n, sizeof(int));
+	for (int i = 0; i < n; i++)
+	{
+		newId[order[i]] = i;
+	}
+
+	int *outOffsets = growArray(NULL, 0, n + 1, sizeof(int));
+	int *outLinks = growArray(NULL, 0, pg->outOffsets[n] + 1, sizeof(int));
+	int *next = growArray(NULL, 0, n, sizeof(int));
+	outOffsets[0] = 0;
+	for (int i = 0; i < n; i++)
+	{
+		outOffsets[i + 1] = outOffsets[i] + pg->outDegree[order[i]];
+		next[i] = outOffsets[i];
+	}
+	for (int v = 0; v < n; v++)
+	{
+		int old = order[v];
+		for (int j = pg->inOffsets[old]; j < pg->inOffsets[old + 1]; j++)
+		{
+			outLinks[next[newId[pg->inLinks[j]]]++] = v;
+		}
+	}
+	free(next);
+	free(pg->outOffsets);
+	free(pg->outLinks);
+	pg->outOffsets = outOffsets;
+	pg->outLinks = outLinks;
+
+	permuteArray(pg->urls, order, n, sizeof(char *));
+	permuteArray(pg->outDegree, order, n, sizeof(int));
+	permuteArray(pg->inDegree, order, n, sizeof(int));
+	permuteArray(pg->wIn, order, n, sizeof(double));
+	permuteArray(pg->wOut, order, n, sizeof(double));
+	for (int i = 0; i < n; i++)
+	{
+		MapSet(pg->urlToId, pg->urls[i], i);
+	}
+	if (pg->numRanked == n)
+	{
+		permuteArray(pg->weights, order, n, sizeof(double));
+		permuteArray(pg->oldWeights, order, n, sizeof(double));
+	}
+	else
+	{
+		pg->numRanked = 0;
+	}
+	for (int k = 0; k < pg->numDirty; k++)
+	{
+		pg->dirty[pg->dirtyPages[k]] = false;
+	}
+	for (int k = 0; k < pg->numDirty; k++)
+	{
+		pg->dirtyPages[k] = newId[pg->dirtyPages[k]];
+		pg->dirty[pg->dirtyPages[k]] = true;
+	}
+	free(newId);
+
+	pg->outLinksValid = true;
+	pg->listsValid = false;
+	pg->inLinksValid = false;
+	pg->inCoeffValid = false;
+}
+
+// Moves element order[i] of the n elements of array to position i.
+static void permuteArray(void *array, const int *order, int n, size_t size)
+{
+	char *copy = growArray(NULL, 0, n, size);
+	memcpy(copy, array, n * size);
+	for (int i = 0; i < n; i++)
+	{
+		memcpy((char *)array + i * size, copy + order[i] * size, size);
+	}
+	free(copy);
+}
+
+// Builds the in-link index, a transposed compressed sparse row copy of the
+// out-links. The in-links of page i are the source ids stored in
+// inLinks[inOffsets[i]] to inLinks[inOffsets[i + 1] - 1], in increasing order.
+static void buildInLinks(pageRank pg)
+{
+	int *inOffsets = malloc((pg->numPages + 1) * sizeof(int));
+	int *next = malloc((pg->numPages + 1) * sizeof(int));
+	if (inOffsets == NULL || next == NULL)
+	{
+		fatalError("out of memory");
+	}
+
+	inOffsets[0] = 0;
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		inOffsets[i + 1] = inOffsets[i] + pg->inDegree[i];
+		next[i] = inOffsets[i];
+	}
+	int *inLinks = malloc((inOffsets[pg->numPages] + 1) * sizeof(int));
+	if (inLinks == NULL)
+	{
+		fatalError("out of memory");
+	}
+
+	pgCompileOutLinks(pg);
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		for (int j = pg->outOffsets[i]; j < pg->outOffsets[i + 1]; j++)
+		{
+			inLinks[next[pg->outLinks[j]]++] = i;
+		}
+	}
+	free(next);
+	free(pg->inOffsets);
+	free(pg->inLinks);
+	pg->inOffsets = inOffsets;
+	pg->inLinks = inLinks;
+	pg->inLinksValid = true;
+	pg->inCoeffValid = false;
+}
+
+// Computes the Win * Wout coefficient of every in-link, so that an iteration
+// is a single multiply-accumulate per link. Must be redone whenever the links,
+// wIn or wOut change.
+static void buildInCoefficients(pageRank pg)
+{
+	if (!pg->inLinksValid)
+	{
+		buildInLinks(pg);
+	}
+	double *inCoeff =
+		malloc((pg->inOffsets[pg->numPages] + 1) * sizeof(double));
+	if (inCoeff == NULL)
+	{
+		fatalError("out of memory");
+	}
+	free(pg->inCoeff);
+	pg->inCoeff = inCoeff;
+
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		// pages without outlinks count as 0.5 in the Wout formula
+		double outDegree = pg->outDegree[i] == 0 ? 0.5 : pg->outDegree[i];
+		double inDegree = pg->inDegree[i];
+		for (int j = pg->inOffsets[i]; j < pg->inOffsets[i + 1]; j++)
+		{
+			int in = pg->inLinks[j];
+			pg->inCoeff[j] =
+				(outDegree / pg->wOut[in]) * (inDegree / pg->wIn[in]);
+		}
+	}
+	pg->inCoeffValid = true;
+	pg->inCoeffFValid = false;
+}
+
+void pgPartitionPages(const int *inOffsets, int numPages, int *starts,
+					  int numParts)
+{
+	long totalWork = inOffsets[numPages] + numPages;
+	int page = 0;
+	for (int t = 0; t < numParts; t++)
+	{
+		long target = totalWork * (t + 1) / numParts;
+		starts[t] = page;
+		// leave at least one page for each of the remaining parts
+		int last = numPages - (numParts - t - 1);
+		while (page < last &&
+			   (t == numParts - 1 || inOffsets[page] + page < target))
+		{
+			page++;
+		}
+	}
+	starts[numParts] = page;
+}
+
+void pgRunWorkers(int numWorkers, void *(*run)(void *), void *workers,
+				  size_t workerSize)
+{
+	pthread_t *threads = malloc(numWorkers * sizeof(pthread_t));
+	struct workerStart *starts =
+		malloc(numWorkers * sizeof(struct workerStart));
+	if (threads == NULL || starts == NULL)
+	{
+		fatalError("out of memory");
+	}
+	pthread_mutex_t gate = PTHREAD_MUTEX_INITIALIZER;
+	bool started = false;
+
+	// the calling thread acts as the first worker
+	pthread_mutex_lock(&gate);
+	int numStarted = 1;
+	while (numStarted < numWorkers)
+	{
+		struct workerStart *s = &starts[numStarted];
+		s->gate = &gate;
+		s->started = &started;
+		s->run = run;
+		s->worker = (char *)workers + numStarted * workerSize;
+		if (pthread_create(&threads[numStarted], NULL, startWorker, s) != 0)
+		{
+			break;
+		}
+		numStarted++;
+	}
+	started = numStarted == numWorkers;
+	pthread_mutex_unlock(&gate);
+
+	if (started)
+	{
+		run(workers);
+	}
+	for (int t = 1; t < numStarted; t++)
+	{
+		pthread_join(threads[t], NULL);
+	}
+	pthread_mutex_destroy(&gate);
+	free(threads);
+	free(starts);
+	if (!started)
+	{
+		fatalError("could not create thread");
+	}
+}
+
+// Runs rankCalculator's iterations on the in-link index, in the precision
+// and with the solver set for pg. Returns the number of iterations done.
+static int rankInMemory(pageRank pg, double damping, double minDiff,
+						int maxIt)
+{
+	struct rankJob job;
+	job.pg = pg;
+	job.damping = damping;
+	job.constant = (1.0 - damping) / pg->numPages;
+	job.minDiff = minDiff;
+	job.maxIt = maxIt;
+	job.numIt = 0;
+	job.done = false;
+	job.useFloat = false;
+	job.extrapolate = pg->solver == PG_EXTRAPOLATED;
+
+	int numIt = 0;
+	if (pg->precision != PG_DOUBLE)
+	{
+		numIt = floatIterate(&job);
+	}
+	// the mixed mode refines the single precision weights in double
+	if (pg->precision == PG_DOUBLE ||
+		(pg->precision == PG_MIXED && numIt < maxIt))
+	{
+		job.done = false;
+		if (pg->solver == PG_GAUSS_SEIDEL)
+		{
+			numIt = gaussSeidel(&job);
+		}
+		else
+		{
+			numIt = powerIterate(&job);
+		}
+	}
+	return numIt;
+}
+
+// Runs power iteration for the given job, splitting the pages between
+// pg->numThreads workers. Returns the number of iterations done.
+static int powerIterate(struct rankJob *job)
+{
+	pageRank pg = job->pg;
+	job->numWorkers =
+		pg->numThreads < pg->numPages ? pg->numThreads : pg->numPages;
+	job->workers = malloc(job->numWorkers * sizeof(struct rankWorker));
+	int *starts = malloc((job->numWorkers + 1) * sizeof(int));
+	if (job->workers == NULL || starts == NULL)
+	{
+		fatalError("out of memory");
+	}
+	pgPartitionPages(pg->inOffsets, pg->numPages, starts, job->numWorkers);
+	for (int t = 0; t < job->numWorkers; t++)
+	{
+		job->workers[t].job = job;
+		job->workers[t].start = starts[t];
+		job->workers[t].end = starts[t + 1];
+	}
+	free(starts);
+	pthread_barrier_init(&job->barrier, NULL, job->numWorkers);
+	pgRunWorkers(job->numWorkers, rankWorkerRun, job->workers,
+				 sizeof(struct rankWorker));
+	pthread_barrier_destroy(&job->barrier);
+	free(job->workers);
+	return job->numIt;
+}
+
+// Waits until pgRunWorkers has started every thread, and then runs the
+// thread's worker if they all could be.
+static void *startWorker(void *arg)
+{
+	struct workerStart *s = arg;
+	pthread_mutex_lock(s->gate);
+	bool started = *s->started;
+	pthread_mutex_unlock(s->gate);
+	if (started)
+	{
+		s->run(s->worker);
+	}
+	return NULL;
+}
+
+// Runs the iterations of rankCalculator for one worker's range of pages.
+// After each iteration the first worker adds up the differences of all
+// workers in a fixed order, so the result only depends on the number of
+// workers and not on the timing of the threads. The weight arrays are
+// swapped rather than copied between iterations.
+static void *rankWorkerRun(void *arg)
+{
+	struct rankWorker *w = arg;
+	struct rankJob *job = w->job;
+	pageRank pg = job->pg;
+	while (true)
+	{
+		if (job->useFloat)
+		{
+			for (int i = w->start; i < w->end; i++)
+			{
+				double sum = 0.0;
+				for (int j = pg->inOffsets[i]; j < pg->inOffsets[i + 1]; j++)
+				{
+					sum += pg->oldWeightsF[pg->inLinks[j]] * pg->inCoeffF[j];
+				}
+				pg->weightsF[i] = sum;
+			}
+			w->diff = rankUpdateFloat(
+				&pg->weightsF[w->start], &pg->oldWeightsF[w->start],
+				w->end - w->start, job->damping, job->constant, &w->total);
+		}
+		else
+		{
+			for (int i = w->start; i < w->end; i++)
+			{
+				pg->weights[i] = rawWeightingCalc(pg, i);
+			}
+			w->diff =
+				rankUpdate(&pg->weights[w->start], &pg->oldWeights[w->start],
+						   w->end - w->start, job->damping, job->constant);
+		}
+		pthread_barrier_wait(&job->barrier);
+
+		if (w == &job->workers[0])
+		{
+			double currDiff = 0.0;
+			double total = 0.0;
+			for (int t = 0; t < job->numWorkers; t++)
+			{
+				currDiff += job->workers[t].diff;
+				total += job->workers[t].total;
+			}
+			job->numIt++;
+			statsTraceDiff(currDiff);
+			double minDiff = job->minDiff;
+			if (job->useFloat && minDiff < FLOAT_NOISE * total)
+			{
+				minDiff = FLOAT_NOISE * total;
+			}
+			job->floatMinDiff = minDiff;
+			job->done = job->numIt >= job->maxIt || currDiff < minDiff;
+			if (!job->done && job->useFloat)
+			{
+				float *temp = pg->oldWeightsF;
+				pg->oldWeightsF = pg->weightsF;
+				pg->weightsF = temp;
+			}
+			else if (!job->done)
+			{
+				double *temp = pg->oldWeights;
+				pg->oldWeights = pg->weights;
+				pg->weights = temp;
+			}
+		}
+		pthread_barrier_wait(&job->barrier);
+
+		if (job->done)
+		{
+			return NULL;
+		}
+		if (job->extrapolate)
+		{
+			// oldWeights now holds the latest iterate and weights the one
+			// before it
+			int phase = job->numIt % EXTRAPOLATION_PERIOD;
+			if (phase == EXTRAPOLATION_PERIOD - 3 ||
+				phase == EXTRAPOLATION_PERIOD - 2)
+			{
+				int h = phase - (EXTRAPOLATION_PERIOD - 3);
+				memcpy(&pg->histWeights[h][w->start], &pg->oldWeights[w->start],
+					   (w->end - w->start) * sizeof(double));
+			}
+			else if (phase == 0)
+			{
+				extrapolationDots(pg, w);
+				pthread_barrier_wait(&job->barrier);
+				if (w == &job->workers[0])
+				{
+					job->extrapolated = extrapolationCoefficients(job);
+				}
+				pthread_barrier_wait(&job->barrier);
+				if (job->extrapolated)
+				{
+					double *x = pg->oldWeights;
+					for (int i = w->start; i < w->end; i++)
+					{
+						x[i] = job->beta[0] * pg->histWeights[1][i] +
+							   job->beta[1] * pg->weights[i] +
+							   job->beta[2] * x[i];
+					}
+				}
+				pthread_barrier_wait(&job->barrier);
+			}
+		}
+	}
+}
+
+// Runs in-place Gauss-Seidel sweeps for the given job, so each page uses
+// the weights already updated in the current sweep. Always runs on the
+// calling thread. Returns the number of sweeps done.
+static int gaussSeidel(struct rankJob *job)
+{
+	pageRank pg = job->pg;
+	double currDiff = job->minDiff;
+	while (job->numIt < job->maxIt && job->minDiff <= currDiff)
+	{
+		currDiff = 0.0;
+		for (int i = 0; i < pg->numPages; i++)
+		{
+			double sum = 0.0;
+			for (int j = pg->inOffsets[i]; j < pg->inOffsets[i + 1]; j++)
+			{
+				sum += pg->weights[pg->inLinks[j]] * pg->inCoeff[j];
+			}
+			double currWeight = sum * job->damping + job->constant;
+			currDiff += fabs(currWeight - pg->weights[i]);
+			pg->weights[i] = currWeight;
+		}
+		job->numIt++;
+		statsTraceDiff(currDiff);
+	}
+	return job->numIt;
+}
+
+// Runs power iteration for the given job on single precision copies of the
+// weights and coefficients, which halves the memory traffic of each
+// iteration. Never extrapolates. Stops early once the differences are down
+// to rounding noise, and leaves the result in both weight arrays in double
+// precision. Returns the number of iterations done.
+static int floatIterate(struct rankJob *job)
+{
+	pageRank pg = job->pg;
+	if (pg->numFloatWeights < pg->numPages)
+	{
+		float *weightsF = newFloatArray(pg->numPages);
+		float *oldWeightsF = newFloatArray(pg->numPages);
+		free(pg->weightsF);
+		free(pg->oldWeightsF);
+		pg->weightsF = weightsF;
+		pg->oldWeightsF = oldWeightsF;
+		pg->numFloatWeights = pg->numPages;
+	}
+	if (!pg->inCoeffFValid)
+	{
+		buildFloatCoefficients(pg);
+	}
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		pg->oldWeightsF[i] = pg->oldWeights[i];
+	}
+
+	double minDiff = job->minDiff;
+	bool extrapolate = job->extrapolate;
+	if (pg->precision == PG_MIXED)
+	{
+		job->minDiff *= MIXED_SWITCH;
+	}
+	job->useFloat = true;
+	job->extrapolate = false;
+	powerIterate(job);
+	pg->floatMinDiff = job->floatMinDiff;
+	job->minDiff = minDiff;
+	job->useFloat = false;
+	job->extrapolate = extrapolate;
+
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		pg->weights[i] = pg->weightsF[i];
+	}
+	memcpy(pg->oldWeights, pg->weights, pg->numPages * sizeof(double));
+	return job->numIt;
+}
+
+// Rounds the in-link coefficients to single precision for floatIterate.
+static void buildFloatCoefficients(pageRank pg)
+{
+	int numLinks = pg->inOffsets[pg->numPages];
+	float *inCoeffF = malloc((numLinks + 1) * sizeof(float));
+	if (inCoeffF == NULL)
+	{
+		fatalError("out of memory");
+	}
+	free(pg->inCoeffF);
+	pg->inCoeffF = inCoeffF;
+	for (int j = 0; j < numLinks; j++)
+	{
+		pg->inCoeffF[j] = pg->inCoeff[j];
+	}
+	pg->inCoeffFValid = true;
+}
+
+// Computes this worker's part of the dot products needed for quadratic
+// extrapolation, using the differences y1, y2 and y3 of the last three
+// iterates from the oldest of the last four.
+static void extrapolationDots(pageRank pg, struct rankWorker *w)
+{
+	double dots[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+	for (int i = w->start; i < w->end; i++)
+	{
+		double x0 = pg->histWeights[0][i];
+		double y1 = pg->histWeights[1][i] - x0;
+		double y2 = pg->weights[i] - x0;
+		double y3 = pg->oldWeights[i] - x0;
+		dots[0] += y1 * y1;
+		dots[1] += y1 * y2;
+		dots[2] += y2 * y2;
+		dots[3] += y1 * y3;
+		dots[4] += y2 * y3;
+	}
+	memcpy(w->dots, dots, sizeof(dots));
+}
+
+// Finds the quadratic extrapolation coefficients of Kamvar et al. from the
+// workers' dot products, by solving the 2x2 least squares problem
+// [y1 y2] * gamma = -y3. Returns false if the problem is singular.
+static bool extrapolationCoefficients(struct rankJob *job)
+{
+	double dots[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+	for (int t = 0; t < job->numWorkers; t++)
+	{
+		for (int k = 0; k < 5; k++)
+		{
+			dots[k] += job->workers[t].dots[k];
+		}
+	}
+	double det = dots[0] * dots[2] - dots[1] * dots[1];
+	if (det <= 1e-12 * dots[0] * dots[2])
+	{
+		return false;
+	}
+	double gamma1 = (-dots[3] * dots[2] + dots[4] * dots[1]) / det;
+	double gamma2 = (-dots[4] * dots[0] + dots[3] * dots[1]) / det;
+	// the coefficients of the three latest iterates, scaled to add up to one
+	// so that the extrapolation keeps the fixed point of the iteration
+	double beta0 = gamma1 + gamma2 + 1.0;
+	double beta1 = gamma2 + 1.0;
+	double sum = beta0 + beta1 + 1.0;
+	if (fabs(sum) < 1e-12)
+	{
+		return false;
+	}
+	job->beta[0] = beta0 / sum;
+	job->beta[1] = beta1 / sum;
+	job->beta[2] = 1.0 / sum;
+	return true;
+}
+
+// Makes the weight arrays large enough for every page, keeping the first
+// numKeep weights in oldWeights.
+static void reserveWeights(pageRank pg, int numKeep)
+{
+	if (pg->numWeights >= pg->numPages)
+	{
+		return;
+	}
+	double *weights = newWeightArray(pg->numPages);
+	double *oldWeights = newWeightArray(pg->numPages);
+	double *histWeights[2];
+	histWeights[0] = newWeightArray(pg->numPages);
+	histWeights[1] = newWeightArray(pg->numPages);
+	if (numKeep > 0)
+	{
+		memcpy(oldWeights, pg->oldWeights, numKeep * sizeof(double));
+	}
+	free(pg->weights);
+	free(pg->oldWeights);
+	free(pg->histWeights[0]);
+	free(pg->histWeights[1]);
+	pg->weights = weights;
+	pg->oldWeights = oldWeights;
+	pg->histWeights[0] = histWeights[0];
+	pg->histWeights[1] = histWeights[1];
+	pg->numWeights = pg->numPages;
+}
+
+// Allocates an array of n weights aligned to a cache line.
+static double *newWeightArray(int n)
+{
+	void *weights;
+	if (posix_memalign(&weights, 64, (n + 1) * sizeof(double)) != 0)
+	{
+		fatalError("out of memory");
+	}
+	return weights;
+}
+
+// Allocates an array of n single precision weights aligned to a cache line.
+static float *newFloatArray(int n)
+{
+	void *weights;
+	if (posix_memalign(&weights, 64, (n + 1) * sizeof(float)) != 0)
+	{
+		fatalError("out of memory");
+	}
+	return weights;
+}
+
+// Inserts the given value into the adjacency list if it is not there already.
+static AdjList adjListInsert(pageRank pg, AdjList l, int v)
+{
+	AdjList *next = &l;
+	while (*next != NULL && (*next)->v < v)
+	{
+		next = &(*next)->next;
+	}
+	if (*next == NULL || (*next)->v != v)
+	{
+		AdjList new = newAdjNode(pg, v);
+		new->next = *next;
+		*next = new;
+	}
+	return l;
+}
+
+// Creates a new adjacency node, reusing a freed one if there is one.
+static AdjList newAdjNode(pageRank pg, int v)
+{
+	AdjList n = pg->freeNodes;
+	if (n != NULL)
+	{
+		pg->freeNodes = n->next;
+	}
+	else
+	{
+		n = ArenaAlloc(pg->arena, sizeof(*n));
+	}
+	n->v = v;
+	n->next = NULL;
+	return n;
+}
+
+// Moves the nodes of the given adjacency list to the graph's free list.
+static void freeAdjList(pageRank pg, AdjList l)
+{
+	if (l == NULL)
+	{
+		return;
+	}
+	AdjList last = l;
+	while (last->next != NULL)
+	{
+		last = last->next;
+	}
+	last->next = pg->freeNodes;
+	pg->freeNodes = l;
+}
+
+// Checks whether a node already exists in an adjacency list.
+// Returns true if it does exist, else it returns false.
+static bool inAdjList(AdjList l, int v)
+{
+	for (AdjList n = l; n != NULL && n->v <= v; n = n->next)
+	{
+		if (n->v == v)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Orders pages by decreasing weight, and pages with the same weight by
+// name.
+static int compareOrderUrls(const void *a, const void *b)
+{
+	const struct orderUrl *u1 = a;
+	const struct orderUrl *u2 = b;
+	if (u1->weight != u2->weight)
+	{
+		return u1->weight > u2->weight ? -1 : 1;
+	}
+	return strcmp(u1->s, u2->s);
+}
+
+// Returns a new array of the first *k pages in the order of orderUrls,
+// first limiting *k to the number of pages.
+static struct orderUrl *sortTopUrls(pageRank pg, int *k)
+{
+	if (*k > pg->numPages)
+	{
+		*k = pg->numPages;
+	}
+	if (*k < 0)
+	{
+		*k = 0;
+	}
+	struct orderUrl *orderUrl = malloc((*k + 1) * sizeof(struct orderUrl));
+	if (orderUrl == NULL)
+	{
+		fatalError("out of memory");
+	}
+	selectTopUrls(pg, orderUrl, *k);
+	qsort(orderUrl, *k, sizeof(struct orderUrl), compareOrderUrls);
+	return orderUrl;
+}
+
+// Stores the k pages that come first in the order of compareOrderUrls in
+// orderUrl, in no particular order. When k is smaller than the number of
+// pages, they are kept in a heap whose root is the page that comes last,
+// so each page costs O(log k) at most.
+static void selectTopUrls(pageRank pg, struct orderUrl *orderUrl, int k)
+{
+	int size = 0;
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		struct orderUrl u = {pg->urls[i], pg->weights[i], pg->outDegree[i]};
+		if (size < k)
+		{
+			// sift up
+			int j = size++;
+			while (j > 0 &&
+				   compareOrderUrls(&orderUrl[(j - 1) / 2], &u) < 0)
+			{
+				orderUrl[j] = orderUrl[(j - 1) / 2];
+				j = (j - 1) / 2;
+			}
+			orderUrl[j] = u;
+		}
+		else if (k > 0 && compareOrderUrls(&u, &orderUrl[0]) < 0)
+		{
+			orderUrl[0] = u;
+			siftDown(orderUrl, size, 0);
+		}
+	}
+}
+
+// Moves the page at position i of the heap down until neither of its
+// children comes after it.
+static void siftDown(struct orderUrl *heap, int size, int i)
+{
+	struct orderUrl u = heap[i];
+	for (;;)
+	{
+		int child = 2 * i + 1;
+		if (child >= size)
+		{
+			break;
+		}
+		if (child + 1 < size &&
+			compareOrderUrls(&heap[child + 1], &heap[child]) > 0)
+		{
+			child++;
+		}
+		if (compareOrderUrls(&heap[child], &u) <= 0)
+		{
+			break;
 		}
+		heap[i] = heap[child];
+		i = child;
 	}
+	heap[i] = u;
 }
 
 // Prints the weights of the pages in the given pageRank graph.
@@ -464,6 +1852,6 @@ void printWeights(pageRank pg)
 {
 	for (int i = 0; i < pg->numPages; i++)
 	{
-		printf("%s: %.7lf\n", pg->urls[i], pg->url[i]->weight);
+		printf("%s: %.7lf\n", pg->urls[i], pg->weights[i]);
 	}
 }
\ No newline at end of file
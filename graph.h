@@ -5,12 +5,58 @@
 #ifndef PG_H
 #define PG_H
 
+#include <stddef.h>
+
 #include "List.h"
 
 typedef struct adjNode *AdjList;
 typedef struct urlnode *urlNode;
 typedef struct pagerank *pageRank;
 
+/**
+ * The methods rankCalculator can use to find the weights.
+ * PG_JACOBI        plain power iteration, the default
+ * PG_GAUSS_SEIDEL  in-place sweeps that use weights from the current sweep
+ * PG_EXTRAPOLATED  power iteration with quadratic (Aitken-style) extrapolation every
+ *                  10 iterations
+ **/
+typedef enum
+{
+	PG_JACOBI,
+	PG_GAUSS_SEIDEL,
+	PG_EXTRAPOLATED,
+} pgSolver;
+
+/**
+ * The precisions rankCalculator can iterate in.
+ * PG_DOUBLE  double precision weights and coefficients, the default
+ * PG_FLOAT   single precision weights and coefficients
+ * PG_MIXED   single precision iterations finished with double precision ones
+ **/
+typedef enum
+{
+	PG_DOUBLE,
+	PG_FLOAT,
+	PG_MIXED,
+} pgPrecision;
+
+/**
+ * The orders pgReorder can give the pages.
+ * PG_ORDER_NONE    the order the pages were added in, the default
+ * PG_ORDER_DEGREE  by decreasing number of out-links, as rankCalculator reads the weight of a
+ *                  page once for each of its out-links
+ * PG_ORDER_RCM     reverse Cuthill-McKee, so that linked pages get nearby ids
+ * PG_ORDER_HUBS    hub clustering: each page with more out-links than the average, followed by
+ *                  the pages it is linked with
+ **/
+typedef enum
+{
+	PG_ORDER_NONE,
+	PG_ORDER_DEGREE,
+	PG_ORDER_RCM,
+	PG_ORDER_HUBS,
+} pgOrdering;
+
 ////////////////////////////////////////////////////////////////////////
 
 /**
@@ -36,6 +82,55 @@ bool pgAddLink(pageRank pg, char *name);
  */
 bool pgLink(pageRank pg, char *url1, char *url2);
 
+/**
+ * Links two pages given by their ids, following the same rules as pgLink.
+ **/
+bool pgLinkIds(pageRank pg, int id1, int id2);
+
+/**
+ * Adds the links from src[k] to dst[k] for k below numLinks, given as page ids, following the
+ * same rules as pgLink: self-links and links that already exist are skipped. Returns the number
+ * of links added. Sorts all the links at once, so it is much faster than calling pgLinkIds
+ * for each link when adding many links.
+ **/
+int pgLinkMany(pageRank pg, const int *src, const int *dst, int numLinks);
+
+/**
+ * Removes the link from url1 to url2. Returns true if successful, and false if they were not
+ * linked.
+ **/
+bool pgUnlink(pageRank pg, char *url1, char *url2);
+
+/**
+ * Removes the link between two pages given by their ids, following the same rules as pgUnlink.
+ **/
+bool pgUnlinkIds(pageRank pg, int id1, int id2);
+
+/**
+ * Removes the page with the given URL and all links from and to it. The page with the biggest id
+ * takes the id of the removed page. Returns true if successful, and false if there is no such page.
+ **/
+bool pgRemovePage(pageRank pg, char *name);
+
+/**
+ * Gives the pages new ids in the given order, so that the weights read together during an iteration
+ * sit close together in memory. Every page keeps its URL and links, so the ranking is the same
+ * apart from rounding, but the ids returned by pgUrlId change. Best called after loading and before
+ * wInCalc. Weights from an earlier rankCalculator are kept for a warm start.
+ **/
+void pgReorder(pageRank pg, pgOrdering ordering);
+
+/**
+ * Returns the id of the page whose URL is the first len characters of url, which need not be
+ * null-terminated, or -1 if there is no such page. Ids are given out in the order pages are added.
+ **/
+int pgUrlId(pageRank pg, const char *url, size_t len);
+
+/**
+ * Returns the number of pages in the graph.
+ **/
+int pgNumPages(pageRank pg);
+
 /**
  * Calculates the Op value in the Win formula for every node in the given pageRank graph.
  **/
@@ -46,11 +141,80 @@ void wInCalc(pageRank pg);
  **/
 void wOutCalc(pageRank pg);
 
+/**
+ * Brings the Win and Wout values up to date after pages or links were added or removed. Only
+ * the pages whose links or degrees changed since the values were last calculated, and the pages
+ * linking to them, are recalculated. Calls wInCalc and wOutCalc if they have not been called yet.
+ **/
+void pgUpdateW(pageRank pg);
+
+/**
+ * Sets the number of threads used by rankCalculator. The pages are split between the
+ * threads by their number of in-links. Results are identical between runs with the same
+ * number of threads.
+ **/
+void pgSetThreads(pageRank pg, int numThreads);
+
+/**
+ * Sets the method used by rankCalculator. All methods use the same stopping criterion.
+ * PG_GAUSS_SEIDEL always runs on a single thread.
+ **/
+void pgSetSolver(pageRank pg, pgSolver solver);
+
+/**
+ * Sets whether rankCalculator starts from the weights found by its last call instead of 1/N.
+ * Pages added since then still start at 1/N. After a small change to the graph, a warm start
+ * needs far fewer iterations to converge. Off by default.
+ **/
+void pgSetWarmStart(pageRank pg, bool warmStart);
+
+/**
+ * Sets the precision used by rankCalculator. PG_FLOAT and PG_MIXED run their single precision
+ * iterations with the Jacobi method, whatever the solver. Single precision cannot resolve
+ * differences below 16 * FLT_EPSILON of the total weight (about 1.9e-6 when the weights add up
+ * to 1), so those iterations stop there even if minDiff is smaller: PG_FLOAT raises minDiff to
+ * that floor, and pgFloatMinDiff returns the value it stopped at. PG_MIXED switches to double
+ * precision once the difference is below 4 * minDiff or the floor, and finishes with the solver at
+ * the requested minDiff; both parts count towards maxIt.
+ * Tolerance: PG_FLOAT's weights are within about damping / (1 - damping) times the floor of the
+ * converged weights, added up over all pages (about 1.1e-5 at damping 0.85). On the test
+ * collections the weights printed by orderUrls (7 decimals) differed from PG_DOUBLE's by up to
+ * 7e-7, and pages whose weights are that close may swap places. PG_MIXED is as accurate as
+ * PG_DOUBLE at the same minDiff, but the switch of precision can cost a few more iterations (up to
+ * 2 on the test collections).
+ **/
+void pgSetPrecision(pageRank pg, pgPrecision precision);
+
+/**
+ * Returns the difference at which the single precision iterations of the last rankCalculator call
+ * stopped, minDiff as raised to the floor of single precision if it was below it, or 0 if there
+ * were none.
+ **/
+double pgFloatMinDiff(pageRank pg);
+
+/**
+ * Limits the memory rankCalculator uses for its in-link index and weight arrays to about memoryCap
+ * bytes, or removes the limit if memoryCap is 0 (the default). When the in-memory engine would need
+ * more, rankCalculator writes the in-links to a temporary file sorted by destination and streams it
+ * once per iteration instead, keeping only the weight and degree arrays in memory. It finds the
+ * same weights in the same number of iterations. PG_EXTRAPOLATED and the single precision modes
+ * always run in memory.
+ **/
+void pgSetMemoryCap(pageRank pg, size_t memoryCap);
+
 /**
  * The main function that iterates through weight calculations until the maxIteration threshold
  * is surpasses or when the minDiff exceeds the difference between the old and current weights.
+ * Returns the number of iterations used.
+ **/
+int rankCalculator(pageRank pg, double damping, double minDiff, int maxIt);
+
+/**
+ * Makes the given numPages weights the result of the last rankCalculator, so that orderUrls
+ * prints them and a warm start begins from them. Used to print the vectors found by
+ * rankCalculatorBatch.
  **/
-void rankCalculator(pageRank pg, double damping, double minDiff, int maxIt);
+void pgSetWeights(pageRank pg, const double *weights);
 
 /**
  * Calculates the weight for the given page index and returns the value.
@@ -64,8 +228,22 @@ double rawWeightingCalc(pageRank pg, int index);
 double diffPR(pageRank pg);
 
 /**
- * Orders the pages in the given pageRank graph by weight and then alphabetical order. Uses bubble sort twice
- * to order these pages and prints the result to the terminal.
+ * Orders the pages in the given pageRank graph by weight and then alphabetical order, and prints
+ * the result to the terminal.
  **/
 void orderUrls(pageRank pg);
+
+/**
+ * Prints the first k pages in the order of orderUrls. Only the first k pages are sorted, so this
+ * takes O(N log k) time.
+ **/
+void orderUrlsTop(pageRank pg, int k);
+
+/**
+ * Stores the URL, number of out-links and weight of each of the first k pages in the order of
+ * orderUrls in urls, outDegrees and weights, without printing them. The URLs belong to the graph.
+ * Returns the number of pages stored, which is less than k if there are fewer pages.
+ **/
+int pgTopPages(pageRank pg, int k, const char **urls, int *outDegrees,
+			   double *weights);
 #endif
@@ -0,0 +1,115 @@
+// Internals of the pageRank ADT shared by the modules that implement it.
+// Not to be used by programs that only use graph.h.
+
+#ifndef PG_PRIVATE_H
+#define PG_PRIVATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "Arena.h"
+#include "Map.h"
+#include "graph.h"
+
+struct adjNode
+{
+	int v;
+	AdjList next;
+};
+
+// Per-page values are kept in arrays indexed by page id. The URL strings
+// and adjacency nodes are allocated from the graph's arena, and urls
+// points at the URL map's copies of the strings. The out-links are kept
+// both as sorted linked lists, which pgLink updates, and as a compressed
+// sparse row copy (outOffsets/outLinks) that everything else reads; each
+// is rebuilt from the other when it is out of date. Arrays that are
+// rebuilt are allocated before the ones they replace are freed, so that a
+// fatal error caught by a trap leaves the graph whole.
+struct pagerank
+{
+	int numPages;			// number of pages in the graph
+	int capacity;			// the total capacity of pages
+	Arena arena;			// owns the URL strings and adjacency nodes
+	char **urls;			// the id of a page is simply the index
+	Map urlToId;			// maps names to ids, built on first use
+	AdjList *lists;			// adjacency lists, kept in increasing order
+	AdjList freeNodes;		// adjacency nodes freed by buildLists
+	bool listsValid;		// whether the adjacency lists are up to date
+	int *outDegree;			// the number of outlinks of each page
+	int *inDegree;			// the number of links going into each page
+	double *wIn;			// the Op value in the Win formula of each page
+	double *wOut;			// the Op value in the Wout formula of each page
+	int *outOffsets;		// where each page's out-links start in outLinks
+	int *outLinks;			// ids of the pages each page links to
+	bool outLinksValid;		// whether outOffsets and outLinks are up to date
+	int *inOffsets;			// where each page's in-links start in inLinks
+	int *inLinks;			// ids of the pages linking to each page
+	bool inLinksValid;		// whether the in-link index is up to date
+	double *inCoeff;		// the Win * Wout coefficient of each in-link
+	bool inCoeffValid;		// whether inCoeff is up to date
+	int numThreads;			// the number of threads used by rankCalculator
+	double *weights;		// the current weight of each page
+	double *oldWeights;		// the weights from the previous iteration
+	int numWeights;			// the capacity of the weight arrays
+	double *histWeights[2];	// older iterates kept for extrapolation
+	pgSolver solver;		// the method used by rankCalculator
+	pgPrecision precision;	// the precision used by rankCalculator
+	double floatMinDiff;	// where the last float iterations stopped, or 0
+	float *weightsF;		// single precision weights
+	float *oldWeightsF;		// single precision weights of the last iteration
+	int numFloatWeights;	// the capacity of the single precision arrays
+	float *inCoeffF;		// inCoeff rounded to single precision
+	bool inCoeffFValid;		// whether inCoeffF is up to date
+	bool wInValid;			// whether wInCalc has been run
+	bool wOutValid;			// whether wOutCalc has been run
+	bool *dirty;			// whether each page is in dirtyPages
+	int *dirtyPages;		// pages whose Win and Wout may be out of date
+	int numDirty;			// the number of pages in dirtyPages
+	int dirtyCapacity;		// the capacity of dirty and dirtyPages
+	bool warmStart;			// whether rankCalculator starts from old weights
+	int numRanked;			// pages below this id have weights in oldWeights
+	size_t memoryCap;		// rankCalculator's memory limit, 0 if none
+	void *snapshot;			// the mapped snapshot the graph is read from
+	size_t snapshotSize;	// the size of the mapped snapshot
+};
+
+/**
+ * Creates a pageRank graph whose URLs, degrees and out-links live in a
+ * mapped snapshot of the given size. The graph takes ownership of the
+ * mapping and of the urls array (but not of the strings it points to),
+ * and copies them to the heap the first time it is modified.
+ **/
+pageRank pgNewMapped(void *snapshot, size_t snapshotSize, int numPages,
+					 char **urls, int *outDegree, int *inDegree,
+					 int *outOffsets, int *outLinks);
+
+/**
+ * Brings outOffsets and outLinks up to date with the adjacency lists.
+ **/
+void pgCompileOutLinks(pageRank pg);
+
+/**
+ * Brings the in-link index and its Win * Wout coefficients up to date.
+ **/
+void pgCompileInCoefficients(pageRank pg);
+
+/**
+ * Splits the pages into numParts contiguous ranges with about the same number
+ * of in-links (plus one per page) each, given where each page's in-links start
+ * in the in-link index. Part t is pages starts[t] to starts[t + 1] - 1.
+ **/
+void pgPartitionPages(const int *inOffsets, int numPages, int *starts,
+					  int numParts);
+
+/**
+ * Calls run on each of the numWorkers workers, the array of workerSize byte
+ * structs at workers, at the same time: on the calling thread for the first
+ * and on a thread of its own for each of the others. Returns once every call
+ * has returned. None of them is made until every thread has been started, so
+ * if a thread cannot be created, the threads already started are joined
+ * before fatalError is called, and no worker is left waiting on the others.
+ **/
+void pgRunWorkers(int numWorkers, void *(*run)(void *), void *workers,
+				  size_t workerSize);
+
+#endif
@@ -0,0 +1,376 @@
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fatal.h"
+#include "fileUtil.h"
+#include "graph.h"
+#include "loader.h"
+
+// The out-links of the pages parsed by one worker, one after another.
+struct linkBuffer
+{
+	int *ids;
+	int size;
+	int capacity;
+};
+
+// Where a page's out-links were stored, or why they could not be read.
+struct pageLinks
+{
+	int worker;	 // the worker that parsed the page
+	int start;	 // the position of the first link in the worker's buffer
+	int count;	 // the number of links
+	char *error; // the error message if the page could not be parsed
+};
+
+struct loadJob
+{
+	pageRank pg;
+	const char *dir;
+	struct token *pages;		// the page names in collection order
+	int numPages;
+	struct pageLinks *links;	// the out-links of each page in pages
+	atomic_int next;			// the next page to be parsed
+	struct linkBuffer *buffers;	// the out-links found by each worker
+};
+
+struct loadWorker
+{
+	struct loadJob *job;
+	int index;
+	bool failed;		   // whether the worker hit a fatal error
+	struct fatalTrap trap; // where it was caught
+};
+
+static void *loadWorkerRun(void *arg);
+static char *parseLinks(pageRank pg, const char *path, struct linkBuffer *b);
+static void appendLink(struct linkBuffer *b, int id);
+static char *makePath(const char *dir, struct token *page, char **path,
+					  size_t *pathCap);
+static char *errorMessage(const char *format, ...);
+
+////////////////////////////////////////////////////////////////////////
+
+pageRank loadCollection(const char *dir, int numThreads)
+{
+	char *error;
+	pageRank pg = loadCollectionError(dir, numThreads, &error);
+	if (pg == NULL)
+	{
+		fprintf(stderr, "error: %s\n", error);
+		free(error);
+	}
+	return pg;
+}
+
+pageRank loadCollectionError(const char *dir, int numThreads, char **error)
+{
+	char *path = NULL;
+	size_t pathCap = 0;
+	struct token collectionName = {"collection", strlen("collection")};
+	makePath(dir, &collectionName, &path, &pathCap);
+	struct mappedFile collection;
+	if (!mapFile(path, &collection))
+	{
+		*error = errorMessage("cannot open '%s'", path);
+		free(path);
+		return NULL;
+	}
+	free(path);
+
+	// add every page first, so links can refer to pages listed later.
+	// After this the URL map is only read, so the workers can share it.
+	struct loadJob job;
+	job.pg = pageRankNew();
+	job.dir = dir;
+	job.numPages = 0;
+	int capacity = 64;
+	job.pages = malloc(capacity * sizeof(struct token));
+	char *name = NULL;
+	size_t nameCap = 0;
+	const char *pos = collection.data;
+	const char *end = collection.data + collection.size;
+	struct token t;
+	while (nextToken(&pos, end, &t))
+	{
+		if (job.numPages == capacity)
+		{
+			capacity *= 2;
+			job.pages = realloc(job.pages, capacity * sizeof(struct token));
+		}
+		if (t.len + 1 > nameCap)
+		{
+			nameCap = 2 * (t.len + 1);
+			name = realloc(name, nameCap);
+		}
+		if (job.pages == NULL || name == NULL)
+		{
+			fatalError("out of memory");
+		}
+		job.pages[job.numPages++] = t;
+		memcpy(name, t.s, t.len);
+		name[t.len] = '\0';
+		pgAddLink(job.pg, name);
+	}
+	free(name);
+
+	int numWorkers = numThreads < 1 ? 1 : numThreads;
+	if (numWorkers > job.numPages)
+	{
+		numWorkers = job.numPages > 0 ? job.numPages : 1;
+	}
+	job.links = calloc(job.numPages + 1, sizeof(struct pageLinks));
+	job.buffers = calloc(numWorkers, sizeof(struct linkBuffer));
+	struct loadWorker *workers = malloc(numWorkers * sizeof(*workers));
+	pthread_t *threads = malloc(numWorkers * sizeof(pthread_t));
+	if (job.links == NULL || job.buffers == NULL || workers == NULL ||
+		threads == NULL)
+	{
+		fatalError("out of memory");
+	}
+	atomic_init(&job.next, 0);
+
+	// the calling thread acts as the first worker
+	for (int w = 0; w < numWorkers; w++)
+	{
+		workers[w].job = &job;
+		workers[w].index = w;
+		workers[w].failed = false;
+	}
+	for (int w = 1; w < numWorkers; w++)
+	{
+		if (pthread_create(&threads[w], NULL, loadWorkerRun, &workers[w]) != 0)
+		{
+			// the workers that could be started parse every page anyway
+			numWorkers = w;
+			break;
+		}
+	}
+	loadWorkerRun(&workers[0]);
+	for (int w = 1; w < numWorkers; w++)
+	{
+		pthread_join(threads[w], NULL);
+	}
+
+	// pass on a fatal error of a worker as if it happened on this thread
+	struct fatalTrap *failure = NULL;
+	for (int w = 0; w < numWorkers; w++)
+	{
+		if (workers[w].failed && failure == NULL)
+		{
+			failure = &workers[w].trap;
+		}
+	}
+
+	// report the first error in collection order, as a serial load would
+	bool ok = failure == NULL;
+	*error = NULL;
+	size_t numLinks = 0;
+	for (int p = 0; p < job.numPages; p++)
+	{
+		struct pageLinks *l = &job.links[p];
+		if (ok && l->error != NULL)
+		{
+			*error = l->error;
+			ok = false;
+		}
+		else
+		{
+			free(l->error);
+		}
+		numLinks += l->count;
+	}
+
+	// then add all the links at once
+	if (ok)
+	{
+		int *src = malloc((numLinks + 1) * sizeof(int));
+		int *dst = malloc((numLinks + 1) * sizeof(int));
+		if (src == NULL || dst == NULL)
+		{
+			fatalError("out of memory");
+		}
+		size_t n = 0;
+		for (int p = 0; p < job.numPages; p++)
+		{
+			struct pageLinks *l = &job.links[p];
+			int id = pgUrlId(job.pg, job.pages[p].s, job.pages[p].len);
+			int *ids = &job.buffers[l->worker].ids[l->start];
+			for (int i = 0; i < l->count; i++)
+			{
+				src[n] = id;
+				dst[n] = ids[i];
+				n++;
+			}
+		}
+		pgLinkMany(job.pg, src, dst, n);
+		free(src);
+		free(dst);
+	}
+
+	for (int w = 0; w < numWorkers; w++)
+	{
+		free(job.buffers[w].ids);
+	}
+	free(job.buffers);
+	free(threads);
+	free(job.links);
+	free(job.pages);
+	unmapFile(&collection);
+	if (!ok)
+	{
+		pgFree(job.pg);
+	}
+	if (failure != NULL)
+	{
+		char message[FATAL_MESSAGE_SIZE];
+		memcpy(message, failure->message, sizeof(message));
+		free(workers);
+		fatalError("%s", message);
+	}
+	free(workers);
+	return ok ? job.pg : NULL;
+}
+
+// Parses pages until there are none left, taking the next unparsed page
+// each time. A fatal error stops the worker and is left for the thread
+// that started the load to report.
+static void *loadWorkerRun(void *arg)
+{
+	struct loadWorker *w = arg;
+	if (setjmp(w->trap.env) != 0)
+	{
+		w->failed = true;
+		return NULL;
+	}
+	fatalSetTrap(&w->trap);
+	struct loadJob *job = w->job;
+	struct linkBuffer *b = &job->buffers[w->index];
+	char *path = NULL;
+	size_t pathCap = 0;
+	int p;
+	while ((p = atomic_fetch_add(&job->next, 1)) < job->numPages)
+	{
+		struct pageLinks *l = &job->links[p];
+		l->worker = w->index;
+		l->start = b->size;
+		makePath(job->dir, &job->pages[p], &path, &pathCap);
+		l->error = parseLinks(job->pg, path, b);
+		l->count = b->size - l->start;
+	}
+	free(path);
+	fatalClearTrap(&w->trap);
+	return NULL;
+}
+
+// Appends the ids of the links in Section-1 of the given page file to the
+// buffer. Returns NULL on success, or an error message if the file is
+// missing or malformed.
+static char *parseLinks(pageRank pg, const char *path, struct linkBuffer *b)
+{
+	struct mappedFile f;
+	if (!mapFile(path, &f))
+	{
+		return errorMessage("cannot open '%s'", path);
+	}
+
+	const char *pos = f.data;
+	const char *end = f.data + f.size;
+	struct token t;
+	bool found = false;
+	while (!found && nextToken(&pos, end, &t))
+	{
+		found = tokenIs(&t, "Section-1");
+	}
+	if (!found)
+	{
+		unmapFile(&f);
+		return errorMessage("'%s' has no Section-1", path);
+	}
+
+	bool closed = false;
+	while (nextToken(&pos, end, &t))
+	{
+		if (tokenIs(&t, "#end"))
+		{
+			closed = true;
+			break;
+		}
+		int outId = pgUrlId(pg, t.s, t.len);
+		if (outId < 0)
+		{
+			char *error = errorMessage("url '%.*s' does not exist!",
+									   (int)t.len, t.s);
+			unmapFile(&f);
+			return error;
+		}
+		appendLink(b, outId);
+	}
+	unmapFile(&f);
+	if (!closed)
+	{
+		return errorMessage("'%s' has no #end after Section-1", path);
+	}
+	return NULL;
+}
+
+static void appendLink(struct linkBuffer *b, int id)
+{
+	if (b->size == b->capacity)
+	{
+		b->capacity = b->capacity == 0 ? 1024 : 2 * b->capacity;
+		b->ids = realloc(b->ids, b->capacity * sizeof(int));
+		if (b->ids == NULL)
+		{
+			fatalError("out of memory");
+		}
+	}
+	b->ids[b->size++] = id;
+}
+
+// Builds the path dir/<page>.txt in *path, growing it as needed.
+static char *makePath(const char *dir, struct token *page, char **path,
+					  size_t *pathCap)
+{
+	size_t dirLen = strlen(dir);
+	size_t len = dirLen + 1 + page->len + strlen(".txt") + 1;
+	if (len > *pathCap)
+	{
+		*pathCap = 2 * len;
+		*path = realloc(*path, *pathCap);
+		if (*path == NULL)
+		{
+			fatalError("out of memory");
+		}
+	}
+	memcpy(*path, dir, dirLen);
+	(*path)[dirLen] = '/';
+	memcpy(*path + dirLen + 1, page->s, page->len);
+	strcpy(*path + dirLen + 1 + page->len, ".txt");
+	return *path;
+}
+
+// Formats an error message into a newly allocated string.
+static char *errorMessage(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+
+	char *message = malloc(len + 1);
+	if (message == NULL)
+	{
+		fatalError("out of memory");
+	}
+	va_start(args, format);
+	vsnprintf(message, len + 1, format, args);
+	va_end(args);
+	return message;
+}
@@ -0,0 +1,20 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include "graph.h"
+
+// Loads the pages listed in dir/collection.txt, and the links in the
+// Section-1 of each page file dir/<url>.txt, into a new pageRank graph.
+// Files are memory-mapped and scanned in place, so URLs can be of any
+// length. The page files are parsed by numThreads threads, and their
+// links are then added in collection order, so the graph is the same
+// for any number of threads. Prints a message and returns NULL if a file
+// is missing or malformed.
+pageRank loadCollection(const char *dir, int numThreads);
+
+// The same as loadCollection, but instead of printing the message when a
+// file is missing or malformed, stores it in *error for the caller to
+// free.
+pageRank loadCollectionError(const char *dir, int numThreads, char **error);
+
+#endif
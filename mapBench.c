@@ -0,0 +1,109 @@
+// Measures the insert and lookup throughput of the Map ADT on sorted and
+// shuffled sets of URL-like keys.
+//
+// Usage: ./mapBench [numKeys]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Map.h"
+
+#define DEFAULT_NUM_KEYS 1000000
+#define MAXKEY 32
+
+static void runBench(char *label, char **keys, int numKeys);
+static double elapsed(struct timespec *start);
+static int qsortStrcmp(const void *ptr1, const void *ptr2);
+
+int main(int argc, char *argv[])
+{
+	int numKeys = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+	if (numKeys <= 0)
+	{
+		fprintf(stderr, "Usage: %s [numKeys]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	char **keys = malloc(numKeys * sizeof(char *));
+	char *storage = malloc((size_t)numKeys * MAXKEY);
+	if (keys == NULL || storage == NULL)
+	{
+		fprintf(stderr, "error: out of memory\n");
+		return EXIT_FAILURE;
+	}
+	for (int i = 0; i < numKeys; i++)
+	{
+		keys[i] = &storage[(size_t)i * MAXKEY];
+		snprintf(keys[i], MAXKEY, "url%d", i);
+	}
+
+	qsort(keys, numKeys, sizeof(char *), qsortStrcmp);
+	runBench("sorted", keys, numKeys);
+
+	srand(2521);
+	for (int i = numKeys - 1; i > 0; i--)
+	{
+		int j = rand() % (i + 1);
+		char *temp = keys[i];
+		keys[i] = keys[j];
+		keys[j] = temp;
+	}
+	runBench("shuffled", keys, numKeys);
+
+	free(storage);
+	free(keys);
+	return EXIT_SUCCESS;
+}
+
+// Inserts all keys into a new map, then looks every key up, and prints the
+// throughput of both phases.
+static void runBench(char *label, char **keys, int numKeys)
+{
+	struct timespec start;
+	Map m = MapNew();
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < numKeys; i++)
+	{
+		MapSet(m, keys[i], i);
+	}
+	double insertTime = elapsed(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	long check = 0;
+	for (int i = 0; i < numKeys; i++)
+	{
+		if (MapContains(m, keys[i]))
+		{
+			check += MapGet(m, keys[i]);
+		}
+	}
+	double lookupTime = elapsed(&start);
+
+	if (check != (long)numKeys * (numKeys - 1) / 2)
+	{
+		fprintf(stderr, "error: lookups returned the wrong values\n");
+		exit(EXIT_FAILURE);
+	}
+	printf("%-8s %9d keys  insert %7.2f Mkeys/s  lookup %7.2f Mkeys/s\n",
+		   label, numKeys, numKeys / insertTime / 1e6,
+		   numKeys / lookupTime / 1e6);
+	MapFree(m);
+}
+
+// Returns the number of seconds since start.
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int qsortStrcmp(const void *ptr1, const void *ptr2)
+{
+	char *s1 = *(char **)ptr1;
+	char *s2 = *(char **)ptr2;
+	return strcmp(s1, s2);
+}
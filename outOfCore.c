@@ -0,0 +1,555 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "fatal.h"
+#include "graph.h"
+#include "graphPrivate.h"
+#include "outOfCore.h"
+#include "rankKernel.h"
+#include "stats.h"
+
+#define STREAM_BUFFER_LINKS (1 << 18) // in-links per read buffer (1 MiB)
+#define MIN_BUILD_LINKS (1 << 20)	  // in-links gathered per pass at least
+
+// One pass over an edge file. A reader thread fills the two buffers in
+// turn while the ranking thread works through the other one.
+struct edgeStream
+{
+	int fd;
+	long numLinks;			// the number of in-links in the file
+	int *buffers[2];
+	int sizes[2];			// the number of in-links in each full buffer
+	bool full[2];			// whether each buffer is waiting to be used
+	bool failed;			// whether the reader hit a fatal error
+	struct fatalTrap trap;	// where the reader caught it
+	pthread_mutex_t lock;
+	pthread_cond_t changed;	// signalled when a buffer is filled or used
+};
+
+// What a sweep does with the raw weighting of each page.
+struct sweep
+{
+	const double *x; // the weights the raw weightings are computed from
+	double *out;	 // where the results go
+	bool inPlace;	 // whether to update the weights as in Gauss-Seidel
+	double damping;
+	double constant;
+	double diff;	 // the difference of the pages finished in place
+};
+
+static int sweepEdgeFile(pageRank pg, int fd, const int *inOffsets,
+						 double damping, double minDiff, int maxIt);
+static void releaseInLinks(pageRank pg);
+static bool releaseOutLinks(pageRank pg);
+static void restoreOutLinks(pageRank pg, int fd, const int *inOffsets);
+static size_t residentSize(pageRank pg);
+static int *inLinkOffsets(pageRank pg);
+static int writeEdgeFile(pageRank pg, const int *inOffsets);
+static int openTempFile(void);
+static void streamSweep(pageRank pg, int fd, const int *inOffsets,
+						struct sweep *sw);
+static void finishPage(struct sweep *sw, int page, double sum);
+static void *readEdges(void *arg);
+static void readFully(int fd, void *data, size_t size, off_t offset);
+static void writeFully(int fd, const void *data, size_t size);
+
+////////////////////////////////////////////////////////////////////////
+
+size_t inMemoryRankSize(pageRank pg)
+{
+	pgCompileOutLinks(pg);
+	size_t numLinks = pg->outOffsets[pg->numPages];
+	size_t numPages = pg->numPages;
+	// the in-link index, its coefficients and four weight arrays
+	return numLinks * (sizeof(int) + sizeof(double)) +
+		   (numPages + 1) * sizeof(int) + 4 * numPages * sizeof(double);
+}
+
+int outOfCoreRank(pageRank pg, double damping, double minDiff, int maxIt)
+{
+	releaseInLinks(pg);
+	int *inOffsets = inLinkOffsets(pg);
+	int fd = writeEdgeFile(pg, inOffsets);
+	// the edge file holds every link, so the out-links are read back from
+	// it once the iterations are done, or if they fail
+	bool released = releaseOutLinks(pg);
+	struct fatalTrap trap;
+	if (setjmp(trap.env) != 0)
+	{
+		if (released)
+		{
+			restoreOutLinks(pg, fd, inOffsets);
+		}
+		close(fd);
+		fatalError("%s", trap.message);
+	}
+	fatalSetTrap(&trap);
+	int numIt = sweepEdgeFile(pg, fd, inOffsets, damping, minDiff, maxIt);
+	fatalClearTrap(&trap);
+	if (released)
+	{
+		restoreOutLinks(pg, fd, inOffsets);
+	}
+	close(fd);
+	free(inOffsets);
+	return numIt;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Runs the iterations of outOfCoreRank over the edge file fd. Returns the
+// number of iterations done.
+static int sweepEdgeFile(pageRank pg, int fd, const int *inOffsets,
+						 double damping, double minDiff, int maxIt)
+{
+	struct sweep sw;
+	sw.damping = damping;
+	sw.constant = (1.0 - damping) / pg->numPages;
+	int numIt = 0;
+
+	if (pg->solver == PG_GAUSS_SEIDEL)
+	{
+		// the same loop as the in-memory Gauss-Seidel solver
+		double currDiff = minDiff;
+		while (numIt < maxIt && minDiff <= currDiff)
+		{
+			sw.x = pg->weights;
+			sw.out = pg->weights;
+			sw.inPlace = true;
+			sw.diff = 0.0;
+			streamSweep(pg, fd, inOffsets, &sw);
+			currDiff = sw.diff;
+			numIt++;
+			statsTraceDiff(currDiff);
+		}
+	}
+	else
+	{
+		// the differences are added up over the same ranges as the
+		// in-memory engine's workers, so they round the same way
+		int numParts =
+			pg->numThreads < pg->numPages ? pg->numThreads : pg->numPages;
+		int *starts = fatalAllocate((numParts + 1) * sizeof(int));
+		pgPartitionPages(inOffsets, pg->numPages, starts, numParts);
+		while (true)
+		{
+			sw.x = pg->oldWeights;
+			sw.out = pg->weights;
+			sw.inPlace = false;
+			streamSweep(pg, fd, inOffsets, &sw);
+			double currDiff = 0.0;
+			for (int t = 0; t < numParts; t++)
+			{
+				currDiff += rankUpdate(&pg->weights[starts[t]],
+									   &pg->oldWeights[starts[t]],
+									   starts[t + 1] - starts[t], damping,
+									   sw.constant);
+			}
+			numIt++;
+			statsTraceDiff(currDiff);
+			if (numIt >= maxIt || currDiff < minDiff)
+			{
+				break;
+			}
+			double *temp = pg->oldWeights;
+			pg->oldWeights = pg->weights;
+			pg->weights = temp;
+		}
+		free(starts);
+	}
+	return numIt;
+}
+
+// Frees the in-link index and its coefficients, which are rebuilt when
+// the in-memory engine next needs them.
+static void releaseInLinks(pageRank pg)
+{
+	free(pg->inOffsets);
+	free(pg->inLinks);
+	free(pg->inCoeff);
+	free(pg->inCoeffF);
+	pg->inOffsets = NULL;
+	pg->inLinks = NULL;
+	pg->inCoeff = NULL;
+	pg->inCoeffF = NULL;
+	pg->inLinksValid = false;
+	pg->inCoeffValid = false;
+	pg->inCoeffFValid = false;
+}
+
+// Frees the out-link index while the edge file is streamed. Returns
+// whether it was freed, and must be restored from the edge file. The
+// out-links of a mapped snapshot are not freed, but their pages are
+// dropped, to be read from the snapshot again when they are next used.
+static bool releaseOutLinks(pageRank pg)
+{
+	if (pg->snapshot != NULL)
+	{
+		long pageSize = sysconf(_SC_PAGESIZE);
+		uintptr_t start = (uintptr_t)pg->outLinks;
+		uintptr_t end = start + pg->outOffsets[pg->numPages] * sizeof(int);
+		start = (start + pageSize - 1) / pageSize * pageSize;
+		end = end / pageSize * pageSize;
+		if (start < end)
+		{
+			madvise((void *)start, end - start, MADV_DONTNEED);
+		}
+		return false;
+	}
+	free(pg->outOffsets);
+	free(pg->outLinks);
+	pg->outOffsets = NULL;
+	pg->outLinks = NULL;
+	pg->outLinksValid = false;
+	return true;
+}
+
+// Rebuilds the out-link index from the edge file. The in-links of each
+// page are read in increasing order of destination, so the out-links of
+// every page come out in increasing order, as pgCompileOutLinks gives
+// them.
+static void restoreOutLinks(pageRank pg, int fd, const int *inOffsets)
+{
+	int n = pg->numPages;
+	long numLinks = inOffsets[n];
+	pg->outOffsets = fatalAllocate((n + 1) * sizeof(int));
+	pg->outOffsets[0] = 0;
+	for (int i = 0; i < n; i++)
+	{
+		pg->outOffsets[i + 1] = pg->outOffsets[i] + pg->outDegree[i];
+	}
+	pg->outLinks = fatalAllocate((numLinks + 1) * sizeof(int));
+	int *next = fatalAllocate((n + 1) * sizeof(int));
+	memcpy(next, pg->outOffsets, n * sizeof(int));
+	int *buffer = fatalAllocate(STREAM_BUFFER_LINKS * sizeof(int));
+	int page = 0;
+	for (long read = 0; read < numLinks;)
+	{
+		long size = numLinks - read;
+		if (size > STREAM_BUFFER_LINKS)
+		{
+			size = STREAM_BUFFER_LINKS;
+		}
+		readFully(fd, buffer, size * sizeof(int), (off_t)read * sizeof(int));
+		for (int k = 0; k < size; k++, read++)
+		{
+			while (read == inOffsets[page + 1])
+			{
+				page++;
+			}
+			pg->outLinks[next[buffer[k]]++] = page;
+		}
+	}
+	free(next);
+	free(buffer);
+	pg->outLinksValid = true;
+}
+
+// Returns the number of bytes of pg that stay in memory while its edge
+// file is written: the per-page arrays, the weight arrays, the adjacency
+// lists and the arena the URLs and adjacency nodes live in, and the
+// out-link index unless it is in a mapped snapshot.
+static size_t residentSize(pageRank pg)
+{
+	size_t n = pg->numPages;
+	// the degrees, Win, Wout, the URL pointers and the weights
+	size_t size = n * (2 * sizeof(int) + 2 * sizeof(double) +
+					   sizeof(char *)) +
+				  (size_t)pg->numWeights * 4 * sizeof(double) +
+				  (size_t)pg->numFloatWeights * 2 * sizeof(float) +
+				  ArenaSize(pg->arena);
+	if (pg->lists != NULL)
+	{
+		size += (size_t)pg->capacity * sizeof(AdjList);
+	}
+	if (pg->snapshot == NULL)
+	{
+		size += (n + 1 + pg->outOffsets[n]) * sizeof(int);
+	}
+	return size;
+}
+
+// Returns where each page's in-links start in the edge file, from the
+// in-degrees.
+static int *inLinkOffsets(pageRank pg)
+{
+	int *inOffsets = fatalAllocate((pg->numPages + 1) * sizeof(int));
+	inOffsets[0] = 0;
+	for (int i = 0; i < pg->numPages; i++)
+	{
+		inOffsets[i + 1] = inOffsets[i] + pg->inDegree[i];
+	}
+	return inOffsets;
+}
+
+// Writes the source of every link to a temporary file, grouped by
+// destination and in increasing order within each group, and returns the
+// file's descriptor. The out-links are scanned once for each range of
+// destinations whose in-links fit in a buffer of the memory the memory
+// cap leaves over from the graph and the two arrays of in-link offsets.
+static int writeEdgeFile(pageRank pg, const int *inOffsets)
+{
+	int n = pg->numPages;
+	long numLinks = inOffsets[n];
+	size_t arrays = residentSize(pg) + 2 * (size_t)(n + 1) * sizeof(int);
+	long bufferLinks = pg->memoryCap > arrays
+						   ? (long)((pg->memoryCap - arrays) / sizeof(int))
+						   : 0;
+	if (bufferLinks < MIN_BUILD_LINKS)
+	{
+		bufferLinks = MIN_BUILD_LINKS;
+	}
+	for (int i = 0; i < n; i++)
+	{
+		// every range needs room for at least one page
+		if (pg->inDegree[i] > bufferLinks)
+		{
+			bufferLinks = pg->inDegree[i];
+		}
+	}
+	if (bufferLinks > numLinks)
+	{
+		bufferLinks = numLinks;
+	}
+
+	int fd = openTempFile();
+	int *buffer = fatalAllocate((bufferLinks + 1) * sizeof(int));
+	int *next = fatalAllocate((n + 1) * sizeof(int));
+	for (int lo = 0, hi; lo < n; lo = hi)
+	{
+		hi = lo + 1;
+		while (hi < n && inOffsets[hi + 1] - inOffsets[lo] <= bufferLinks)
+		{
+			hi++;
+		}
+		for (int v = lo; v < hi; v++)
+		{
+			next[v] = inOffsets[v] - inOffsets[lo];
+		}
+		for (int i = 0; i < n; i++)
+		{
+			for (int j = pg->outOffsets[i]; j < pg->outOffsets[i + 1]; j++)
+			{
+				int v = pg->outLinks[j];
+				if (v >= lo && v < hi)
+				{
+					buffer[next[v]++] = i;
+				}
+			}
+		}
+		writeFully(fd, buffer,
+				   (size_t)(inOffsets[hi] - inOffsets[lo]) * sizeof(int));
+	}
+	free(buffer);
+	free(next);
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	return fd;
+}
+
+// Creates a file in $TMPDIR, or /tmp if it is not set, that is deleted
+// when it is closed, and returns its descriptor.
+static int openTempFile(void)
+{
+	const char *dir = getenv("TMPDIR");
+	if (dir == NULL || dir[0] == '\0')
+	{
+		dir = "/tmp";
+	}
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/pagerank-edges-XXXXXX", dir);
+	int fd = mkstemp(path);
+	if (fd < 0)
+	{
+		fatalError("could not create an edge file in %s", dir);
+	}
+	unlink(path);
+	return fd;
+}
+
+// Reads the edge file once and passes the raw weighting of every page,
+// computed from the weights sw->x, to finishPage.
+static void streamSweep(pageRank pg, int fd, const int *inOffsets,
+						struct sweep *sw)
+{
+	struct edgeStream s;
+	s.fd = fd;
+	s.numLinks = inOffsets[pg->numPages];
+	for (int b = 0; b < 2; b++)
+	{
+		s.buffers[b] = fatalAllocate(STREAM_BUFFER_LINKS * sizeof(int));
+		s.full[b] = false;
+	}
+	s.failed = false;
+	pthread_mutex_init(&s.lock, NULL);
+	pthread_cond_init(&s.changed, NULL);
+	pthread_t reader;
+	if (pthread_create(&reader, NULL, readEdges, &s) != 0)
+	{
+		fatalError("could not create thread");
+	}
+
+	int page = 0;
+	int end = inOffsets[1]; // where the current page's in-links end
+	double outDegree = pg->outDegree[0] == 0 ? 0.5 : pg->outDegree[0];
+	double inDegree = pg->inDegree[0];
+	double sum = 0.0;
+	long read = 0;
+	for (int b = 0; read < s.numLinks; b = 1 - b)
+	{
+		pthread_mutex_lock(&s.lock);
+		while (!s.full[b] && !s.failed)
+		{
+			pthread_cond_wait(&s.changed, &s.lock);
+		}
+		bool failed = s.failed;
+		pthread_mutex_unlock(&s.lock);
+		if (failed)
+		{
+			// report the reader's error on this thread
+			pthread_join(reader, NULL);
+			fatalError("%s", s.trap.message);
+		}
+
+		const int *links = s.buffers[b];
+		for (int k = 0; k < s.sizes[b]; k++, read++)
+		{
+			while (read == end)
+			{
+				finishPage(sw, page, sum);
+				page++;
+				end = inOffsets[page + 1];
+				// pages without outlinks count as 0.5 in the Wout formula
+				outDegree =
+					pg->outDegree[page] == 0 ? 0.5 : pg->outDegree[page];
+				inDegree = pg->inDegree[page];
+				sum = 0.0;
+			}
+			// the coefficient is rounded exactly as in the in-link index
+			int in = links[k];
+			sum += sw->x[in] *
+				   ((outDegree / pg->wOut[in]) * (inDegree / pg->wIn[in]));
+		}
+
+		pthread_mutex_lock(&s.lock);
+		s.full[b] = false;
+		pthread_cond_signal(&s.changed);
+		pthread_mutex_unlock(&s.lock);
+	}
+	for (; page < pg->numPages; page++)
+	{
+		finishPage(sw, page, sum);
+		sum = 0.0;
+	}
+
+	pthread_join(reader, NULL);
+	pthread_cond_destroy(&s.changed);
+	pthread_mutex_destroy(&s.lock);
+	free(s.buffers[0]);
+	free(s.buffers[1]);
+}
+
+// Stores the raw weighting sum of a page, or for an in-place sweep its new
+// weight, adding the change to the sweep's difference.
+static void finishPage(struct sweep *sw, int page, double sum)
+{
+	if (sw->inPlace)
+	{
+		double currWeight = sum * sw->damping + sw->constant;
+		sw->diff += fabs(currWeight - sw->out[page]);
+		sw->out[page] = currWeight;
+	}
+	else
+	{
+		sw->out[page] = sum;
+	}
+}
+
+// Reads the whole edge file of a stream into its buffers in turn, waiting
+// for each buffer to be used before filling it again. Stops at a fatal
+// error, leaving it for the ranking thread to report.
+static void *readEdges(void *arg)
+{
+	struct edgeStream *s = arg;
+	if (setjmp(s->trap.env) != 0)
+	{
+		pthread_mutex_lock(&s->lock);
+		s->failed = true;
+		pthread_cond_signal(&s->changed);
+		pthread_mutex_unlock(&s->lock);
+		return NULL;
+	}
+	fatalSetTrap(&s->trap);
+	long offset = 0;
+	for (int b = 0; offset < s->numLinks; b = 1 - b)
+	{
+		pthread_mutex_lock(&s->lock);
+		while (s->full[b])
+		{
+			pthread_cond_wait(&s->changed, &s->lock);
+		}
+		pthread_mutex_unlock(&s->lock);
+
+		long size = s->numLinks - offset;
+		if (size > STREAM_BUFFER_LINKS)
+		{
+			size = STREAM_BUFFER_LINKS;
+		}
+		readFully(s->fd, s->buffers[b], size * sizeof(int),
+				  (off_t)offset * sizeof(int));
+		offset += size;
+
+		pthread_mutex_lock(&s->lock);
+		s->sizes[b] = size;
+		s->full[b] = true;
+		pthread_cond_signal(&s->changed);
+		pthread_mutex_unlock(&s->lock);
+	}
+	fatalClearTrap(&s->trap);
+	return NULL;
+}
+
+// Reads size bytes at the given offset of a file. Failing to read them
+// all is a fatal error.
+static void readFully(int fd, void *data, size_t size, off_t offset)
+{
+	char *p = data;
+	while (size > 0)
+	{
+		ssize_t n = pread(fd, p, size, offset);
+		if (n <= 0)
+		{
+			fatalError("could not read the edge file");
+		}
+		p += n;
+		size -= n;
+		offset += n;
+	}
+}
+
+// Appends size bytes to a file. Failing to write them all is a fatal
+// error.
+static void writeFully(int fd, const void *data, size_t size)
+{
+	const char *p = data;
+	while (size > 0)
+	{
+		ssize_t n = write(fd, p, size);
+		if (n <= 0)
+		{
+			fatalError("could not write the edge file");
+		}
+		p += n;
+		size -= n;
+	}
+}
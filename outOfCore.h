@@ -0,0 +1,26 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include <stddef.h>
+
+#include "graph.h"
+
+// Returns the number of bytes rankCalculator's in-memory engine needs for
+// pg: the in-link index, its coefficients and the weight arrays.
+size_t inMemoryRankSize(pageRank pg);
+
+// Runs rankCalculator's iterations with the Jacobi or Gauss-Seidel solver
+// set for pg without an in-link index in memory. The in-links are written
+// to a temporary edge file sorted by destination, which is streamed once
+// per iteration by a reader thread into two buffers, so that reading one
+// overlaps with working through the other. The coefficients are computed
+// as the in-links are read, in the same order as the in-memory engine, so
+// the weights and the number of iterations are the same. Starts from the
+// weights in pg->oldWeights and leaves the result in pg->weights. Returns
+// the number of iterations done. The in-link index is freed, and so is the
+// out-link index while the edge file is streamed; it is read back from the
+// edge file afterwards. What stays in memory is counted against the memory
+// cap when choosing how many links to sort at a time.
+int outOfCoreRank(pageRank pg, double damping, double minDiff, int maxIt);
+
+#endif
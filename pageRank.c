@@ -1,78 +1,333 @@
 #include <assert.h>
 #include <ctype.h>
+#include <getopt.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "fatal.h"
 #include "graph.h"
+#include "loader.h"
+#include "rankBatch.h"
+#include "snapshot.h"
+#include "stats.h"
 
-#define MAXURL 100
+#define OPT_STATS 256 // long options without a short form
 
-pageRank initPages(void);
+static int parseDampings(char *list, double **dampings);
+static void rankBatch(pageRank pg, const double *dampings, int numDampings,
+					  double minDiff, int maxIt, int topK, bool verbose);
+static void printRanking(pageRank pg, int topK);
+static void usage(char *progName);
 
 int main(int argc, char *argv[])
 {
-	if (argc != 4)
+	int numThreads = 1;
+	int numLoadThreads = 1;
+	int topK = -1;
+	char *snapshotPath = NULL;
+	pgSolver solver = PG_JACOBI;
+	pgPrecision precision = PG_DOUBLE;
+	pgOrdering ordering = PG_ORDER_NONE;
+	size_t memoryCap = 0;
+	double *dampings = NULL;
+	int numDampings = 0;
+	bool verbose = false;
+	char *statsPath = NULL;
+	static struct option longOptions[] = {
+		{"stats", required_argument, NULL, OPT_STATS},
+		{NULL, 0, NULL, 0},
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "d:t:j:k:m:o:p:s:S:v", longOptions,
+							  NULL)) != -1)
 	{
-		fprintf(stderr, "Usage: %s dampingFactor diffPR maxIterations\n",
-				argv[0]);
-		return EXIT_FAILURE;
+		switch (opt)
+		{
+		case OPT_STATS:
+			statsPath = optarg;
+			break;
+		case 'd':
+			free(dampings);
+			numDampings = parseDampings(optarg, &dampings);
+			if (numDampings < 1)
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 's':
+			if (strcmp(optarg, "jacobi") == 0)
+			{
+				solver = PG_JACOBI;
+			}
+			else if (strcmp(optarg, "gauss-seidel") == 0)
+			{
+				solver = PG_GAUSS_SEIDEL;
+			}
+			else if (strcmp(optarg, "extrapolated") == 0)
+			{
+				solver = PG_EXTRAPOLATED;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 'm':
+			if (atol(optarg) < 1)
+			{
+				usage(argv[0]);
+			}
+			memoryCap = (size_t)atol(optarg) << 20;
+			break;
+		case 'o':
+			if (strcmp(optarg, "none") == 0)
+			{
+				ordering = PG_ORDER_NONE;
+			}
+			else if (strcmp(optarg, "degree") == 0)
+			{
+				ordering = PG_ORDER_DEGREE;
+			}
+			else if (strcmp(optarg, "rcm") == 0)
+			{
+				ordering = PG_ORDER_RCM;
+			}
+			else if (strcmp(optarg, "hubs") == 0)
+			{
+				ordering = PG_ORDER_HUBS;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 'p':
+			if (strcmp(optarg, "double") == 0)
+			{
+				precision = PG_DOUBLE;
+			}
+			else if (strcmp(optarg, "float") == 0)
+			{
+				precision = PG_FLOAT;
+			}
+			else if (strcmp(optarg, "mixed") == 0)
+			{
+				precision = PG_MIXED;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 'S':
+			snapshotPath = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		case 't':
+			numThreads = atoi(optarg);
+			if (numThreads < 1)
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 'j':
+			numLoadThreads = atoi(optarg);
+			if (numLoadThreads < 1)
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 'k':
+			topK = atoi(optarg);
+			if (topK < 1)
+			{
+				usage(argv[0]);
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	// a list of damping factors takes the place of dampingFactor, and is
+	// only solved with the Jacobi method in double precision and in memory
+	if (argc - optind != (dampings == NULL ? 3 : 2))
+	{
+		usage(argv[0]);
+	}
+	if (dampings != NULL &&
+		(solver != PG_JACOBI || precision != PG_DOUBLE || memoryCap != 0))
+	{
+		usage(argv[0]);
+	}
+	int arg = optind;
+	double damping = dampings == NULL ? atof(argv[arg++]) : 0.0;
+	double minDiff = atof(argv[arg]);
+	int maxIt = atoi(argv[arg + 1]);
+	if (statsPath != NULL)
+	{
+		statsEnable(true);
+	}
+
+	statsPhaseStart(STAT_LOAD);
+	pageRank pg = NULL;
+	if (snapshotPath != NULL)
+	{
+		pg = pgLoadSnapshot(snapshotPath, ".");
+		if (verbose)
+		{
+			fprintf(stderr, "snapshot: %s\n",
+					pg != NULL ? "loaded" : "rebuilt");
+		}
 	}
-	double damping = atof(argv[1]);
-	double minDiff = atof(argv[2]);
-	int maxIt = atoi(argv[3]);
-	pageRank pg = initPages();
+	if (pg == NULL)
+	{
+		pg = loadCollection(".", numLoadThreads);
+		if (pg == NULL)
+		{
+			return EXIT_FAILURE;
+		}
+		if (snapshotPath != NULL && !pgSaveSnapshot(pg, ".", snapshotPath))
+		{
+			fprintf(stderr, "warning: could not write snapshot '%s'\n",
+					snapshotPath);
+		}
+	}
+	statsPhaseEnd(STAT_LOAD);
+	statsPhaseStart(STAT_REORDER);
+	pgReorder(pg, ordering);
+	statsPhaseEnd(STAT_REORDER);
+	pgSetThreads(pg, numThreads);
+	pgSetSolver(pg, solver);
+	pgSetPrecision(pg, precision);
+	pgSetMemoryCap(pg, memoryCap);
+	statsPhaseStart(STAT_WIN);
 	wInCalc(pg);
+	statsPhaseEnd(STAT_WIN);
+	statsPhaseStart(STAT_WOUT);
 	wOutCalc(pg);
-	rankCalculator(pg, damping, minDiff, maxIt);
-	orderUrls(pg);
+	statsPhaseEnd(STAT_WOUT);
+	if (dampings != NULL)
+	{
+		rankBatch(pg, dampings, numDampings, minDiff, maxIt, topK, verbose);
+	}
+	else
+	{
+		statsPhaseStart(STAT_RANK);
+		int numIt = rankCalculator(pg, damping, minDiff, maxIt);
+		statsPhaseEnd(STAT_RANK);
+		if (verbose)
+		{
+			fprintf(stderr, "iterations: %d\n", numIt);
+			if (precision == PG_FLOAT && pgFloatMinDiff(pg) > minDiff)
+			{
+				fprintf(stderr, "diffPR raised to %g, the floor of single "
+								"precision\n",
+						pgFloatMinDiff(pg));
+			}
+		}
+		printRanking(pg, topK);
+	}
 	pgFree(pg);
+	free(dampings);
+	if (statsPath != NULL && !statsWrite(statsPath))
+	{
+		fprintf(stderr, "warning: could not write stats '%s'\n", statsPath);
+	}
 }
 
-// Inititalises the pages from the given file into a pageRank graph.
-pageRank initPages(void)
+// Reads a comma separated list of damping factors into a new array.
+// Returns the number of damping factors, or 0 if the list is malformed.
+static int parseDampings(char *list, double **dampings)
 {
-	pageRank pg = pageRankNew();
-	FILE *collection = fopen("collection.txt", "r");
-	if (collection == NULL)
-	{
-		fprintf(stderr, "File does not exist!");
-		exit(EXIT_FAILURE);
-	}
-	char file[MAXURL];
-	char fileExt[MAXURL + 4];
-	char outLink[MAXURL];
-	char *extension = ".txt";
-	while (fscanf(collection, "%s", file) != EOF)
+	int numDampings = 1;
+	for (char *c = list; *c != '\0'; c++)
 	{
-		pgAddLink(pg, file);
+		numDampings += *c == ',';
 	}
-	fseek(collection, 0, SEEK_SET);
-	while (fscanf(collection, "%s", file) != EOF)
+	*dampings = fatalAllocate(numDampings * sizeof(double));
+	char *next = list;
+	for (int v = 0; v < numDampings; v++)
 	{
-		strcpy(fileExt, file);
-		strcat(fileExt, extension);
-
-		FILE *urlPage = fopen(fileExt, "r");
-		if (urlPage == NULL)
-		{
-			fprintf(stderr, "File does not exist!");
-			exit(EXIT_FAILURE);
-		}
-		while (strcmp(outLink, "Section-1") != 0)
+		char *end;
+		(*dampings)[v] = strtod(next, &end);
+		if (end == next || (*end != ',' && *end != '\0'))
 		{
-			fscanf(urlPage, "%s", outLink);
+			return 0;
 		}
-		fscanf(urlPage, "%s", outLink);
-		while (strcmp(outLink, "#end") != 0)
+		next = end + 1;
+	}
+	return numDampings;
+}
+
+// Ranks the pages once for each damping factor in a single batched
+// calculation and prints each ranking after a line naming its damping
+// factor.
+static void rankBatch(pageRank pg, const double *dampings, int numDampings,
+					  double minDiff, int maxIt, int topK, bool verbose)
+{
+	double **weights = fatalAllocate(numDampings * sizeof(double *));
+	int *numIt = fatalAllocate(numDampings * sizeof(int));
+	int numPages = pgNumPages(pg);
+	for (int v = 0; v < numDampings; v++)
+	{
+		weights[v] = fatalAllocate((numPages + 1) * sizeof(double));
+	}
+	statsPhaseStart(STAT_RANK);
+	rankCalculatorBatch(pg, numDampings, dampings, NULL, minDiff, maxIt,
+						weights, numIt);
+	statsPhaseEnd(STAT_RANK);
+	for (int v = 0; v < numDampings; v++)
+	{
+		if (verbose)
 		{
-			pgLink(pg, file, outLink);
-			fscanf(urlPage, "%s", outLink);
+			fprintf(stderr, "iterations (damping %g): %d\n", dampings[v],
+					numIt[v]);
 		}
-		fclose(urlPage);
+		printf("dampingFactor %g\n", dampings[v]);
+		pgSetWeights(pg, weights[v]);
+		printRanking(pg, topK);
+		free(weights[v]);
+	}
+	free(weights);
+	free(numIt);
+}
+
+// Prints the pages in order of weight, or only the first topK if topK is
+// positive.
+static void printRanking(pageRank pg, int topK)
+{
+	statsPhaseStart(STAT_ORDER);
+	if (topK > 0)
+	{
+		orderUrlsTop(pg, topK);
+	}
+	else
+	{
+		orderUrls(pg);
 	}
-	fclose(collection);
-	return pg;
+	fflush(stdout);
+	statsPhaseEnd(STAT_ORDER);
+}
+
+// Prints the usage message and exits.
+static void usage(char *progName)
+{
+	fprintf(stderr,
+			"Usage: %s [-t threads] [-j loadThreads] [-k topPages] "
+			"[-S snapshot] [-s jacobi|gauss-seidel|extrapolated] "
+			"[-p double|float|mixed] [-o none|degree|rcm|hubs] "
+			"[-m memoryMiB] [-v] [--stats=file.json] "
+			"{dampingFactor | -d damping1,damping2,...} "
+			"diffPR maxIterations\n"
+			"-d solves in memory with the Jacobi method in double "
+			"precision, so it cannot be used with other -s, -p or -m "
+			"options\n",
+			progName);
+	exit(EXIT_FAILURE);
 }
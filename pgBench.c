@@ -0,0 +1,194 @@
+// Times each phase of pageRank on one or more collections: loading the
+// collection, pgReorder, wInCalc, wOutCalc, rankCalculator and orderUrls.
+// Each phase is run the given number of times and the fastest run is
+// reported. The ranking printed by orderUrls is discarded.
+//
+// Usage: ./pgBench [-t threads] [-j loadThreads] [-r repeats]
+//                  [-o none|degree|rcm|hubs] directory...
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "graph.h"
+#include "graphPrivate.h"
+#include "loader.h"
+
+#define DAMPING 0.85
+#define MIN_DIFF 0.00001
+#define MAX_ITERATIONS 1000
+#define DEFAULT_REPEATS 3
+
+// The fastest time of each phase, in seconds.
+struct phaseTimes
+{
+	double load;
+	double reorder;
+	double wIn;
+	double wOut;
+	double rank;
+	double order;
+};
+
+static void usage(char *progName);
+static bool runBench(FILE *out, const char *dir, int numThreads,
+					 int numLoadThreads, int repeats, pgOrdering ordering);
+static void keepFastest(double *best, double time);
+static double elapsed(struct timespec *start);
+
+int main(int argc, char *argv[])
+{
+	int numThreads = 1;
+	int numLoadThreads = 1;
+	int repeats = DEFAULT_REPEATS;
+	pgOrdering ordering = PG_ORDER_NONE;
+	int opt;
+	while ((opt = getopt(argc, argv, "t:j:r:o:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'o':
+			if (strcmp(optarg, "none") == 0)
+			{
+				ordering = PG_ORDER_NONE;
+			}
+			else if (strcmp(optarg, "degree") == 0)
+			{
+				ordering = PG_ORDER_DEGREE;
+			}
+			else if (strcmp(optarg, "rcm") == 0)
+			{
+				ordering = PG_ORDER_RCM;
+			}
+			else if (strcmp(optarg, "hubs") == 0)
+			{
+				ordering = PG_ORDER_HUBS;
+			}
+			else
+			{
+				usage(argv[0]);
+			}
+			break;
+		case 't':
+			numThreads = atoi(optarg);
+			break;
+		case 'j':
+			numLoadThreads = atoi(optarg);
+			break;
+		case 'r':
+			repeats = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind == argc || numThreads < 1 || numLoadThreads < 1 ||
+		repeats < 1)
+	{
+		usage(argv[0]);
+	}
+
+	// orderUrls prints to stdout, so the results go to a copy of it
+	FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+	if (out == NULL || freopen("/dev/null", "w", stdout) == NULL)
+	{
+		fprintf(stderr, "error: cannot redirect stdout\n");
+		return EXIT_FAILURE;
+	}
+	fprintf(out, "%-32s %9s %10s %8s %8s %8s %8s %8s %5s %8s\n",
+			"collection", "pages", "links", "load", "reorder", "wIn", "wOut",
+			"rank", "its", "order");
+	bool ok = true;
+	for (int i = optind; i < argc; i++)
+	{
+		ok = runBench(out, argv[i], numThreads, numLoadThreads, repeats,
+					  ordering) &&
+			 ok;
+	}
+	fclose(out);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Prints the usage message and exits.
+static void usage(char *progName)
+{
+	fprintf(stderr,
+			"Usage: %s [-t threads] [-j loadThreads] [-r repeats] "
+			"[-o none|degree|rcm|hubs] directory...\n",
+			progName);
+	exit(EXIT_FAILURE);
+}
+
+// Runs every phase on the collection in dir and prints one line of times
+// in seconds. Returns false if the collection cannot be loaded.
+static bool runBench(FILE *out, const char *dir, int numThreads,
+					 int numLoadThreads, int repeats, pgOrdering ordering)
+{
+	struct phaseTimes best = {-1.0, -1.0, -1.0, -1.0, -1.0, -1.0};
+	struct timespec start;
+	int numPages = 0;
+	int numLinks = 0;
+	int numIt = 0;
+	for (int r = 0; r < repeats; r++)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		pageRank pg = loadCollection(dir, numLoadThreads);
+		if (pg == NULL)
+		{
+			return false;
+		}
+		keepFastest(&best.load, elapsed(&start));
+		pgSetThreads(pg, numThreads);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		pgReorder(pg, ordering);
+		keepFastest(&best.reorder, elapsed(&start));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		wInCalc(pg);
+		keepFastest(&best.wIn, elapsed(&start));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		wOutCalc(pg);
+		keepFastest(&best.wOut, elapsed(&start));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		numIt = rankCalculator(pg, DAMPING, MIN_DIFF, MAX_ITERATIONS);
+		keepFastest(&best.rank, elapsed(&start));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		orderUrls(pg);
+		fflush(stdout);
+		keepFastest(&best.order, elapsed(&start));
+
+		numPages = pg->numPages;
+		numLinks = pg->outOffsets[pg->numPages];
+		pgFree(pg);
+	}
+	fprintf(out, "%-32s %9d %10d %8.3f %8.3f %8.3f %8.3f %8.3f %5d %8.3f\n",
+			dir, numPages, numLinks, best.load, best.reorder, best.wIn,
+			best.wOut, best.rank, numIt, best.order);
+	fflush(out);
+	return true;
+}
+
+// Replaces the best time with the given time if it is faster, or if
+// there is no best time yet.
+static void keepFastest(double *best, double time)
+{
+	if (*best < 0 || time < *best)
+	{
+		*best = time;
+	}
+}
+
+// Returns the number of seconds since start.
+static double elapsed(struct timespec *start)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
@@ -0,0 +1,352 @@
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fatal.h"
+#include "graph.h"
+#include "graphPrivate.h"
+#include "loader.h"
+#include "pgEngine.h"
+#include "rankBatch.h"
+#include "snapshot.h"
+
+struct pgEngine
+{
+	pageRank pg;					// the loaded collection, or NULL
+	char error[FATAL_MESSAGE_SIZE]; // the description of the last failure
+};
+
+static pgStatus checkResults(pgEngine engine, pgResult *results,
+							int maxResults, int *numResults);
+static bool validDamping(double damping);
+static int storeResults(pageRank pg, pgResult *results, int maxResults);
+static pgStatus failRank(pgEngine engine, const char *message);
+static pgStatus fail(pgEngine engine, pgStatus status, const char *format,
+					 ...);
+
+////////////////////////////////////////////////////////////////////////
+
+pgEngine pgEngineNew(void)
+{
+	pgEngine engine = malloc(sizeof(*engine));
+	if (engine == NULL)
+	{
+		return NULL;
+	}
+	engine->pg = NULL;
+	engine->error[0] = '\0';
+	return engine;
+}
+
+void pgEngineFree(pgEngine engine)
+{
+	if (engine == NULL)
+	{
+		return;
+	}
+	if (engine->pg != NULL)
+	{
+		pgFree(engine->pg);
+	}
+	free(engine);
+}
+
+void pgLoadDefaults(pgLoadOptions *options)
+{
+	options->numThreads = 1;
+	options->snapshotPath = NULL;
+	options->ordering = PG_ORDER_NONE;
+}
+
+void pgRankDefaults(pgRankOptions *options)
+{
+	options->damping = 0.85;
+	options->minDiff = 0.00001;
+	options->maxIt = 1000;
+	options->solver = PG_JACOBI;
+	options->precision = PG_DOUBLE;
+	options->memoryCap = 0;
+	options->warmStart = false;
+}
+
+pgStatus pgEngineLoad(pgEngine engine, const char *dir,
+					  const pgLoadOptions *options)
+{
+	// copied, so that no argument is changed before setjmp is called
+	pgLoadOptions opts;
+	if (options == NULL)
+	{
+		pgLoadDefaults(&opts);
+	}
+	else
+	{
+		opts = *options;
+	}
+	if (dir == NULL || opts.numThreads < 1 ||
+		opts.ordering < PG_ORDER_NONE || opts.ordering > PG_ORDER_HUBS)
+	{
+		return fail(engine, PG_ERR_ARGUMENT, "invalid load options");
+	}
+	if (engine->pg != NULL)
+	{
+		pgFree(engine->pg);
+		engine->pg = NULL;
+	}
+
+	// a graph that is loaded but not yet ready is freed if a fatal error
+	// interrupts the load; memory held by the loader itself is lost
+	pageRank volatile pg = NULL;
+	struct fatalTrap trap;
+	if (setjmp(trap.env) != 0)
+	{
+		if (pg != NULL)
+		{
+			pgFree(pg);
+		}
+		return fail(engine, PG_ERR_FATAL, "%s", trap.message);
+	}
+	fatalSetTrap(&trap);
+	if (opts.snapshotPath != NULL)
+	{
+		pg = pgLoadSnapshot(opts.snapshotPath, dir);
+	}
+	if (pg == NULL)
+	{
+		char *error;
+		pg = loadCollectionError(dir, opts.numThreads, &error);
+		if (pg == NULL)
+		{
+			fatalClearTrap(&trap);
+			pgStatus status = fail(engine, PG_ERR_LOAD, "%s", error);
+			free(error);
+			return status;
+		}
+		if (opts.snapshotPath != NULL)
+		{
+			pgSaveSnapshot(pg, dir, opts.snapshotPath);
+		}
+	}
+	pgReorder(pg, opts.ordering);
+	pgSetThreads(pg, opts.numThreads);
+	wInCalc(pg);
+	wOutCalc(pg);
+	fatalClearTrap(&trap);
+	engine->pg = pg;
+	return PG_OK;
+}
+
+int pgEngineNumPages(pgEngine engine)
+{
+	return engine->pg != NULL ? pgNumPages(engine->pg) : 0;
+}
+
+pgStatus pgEngineRank(pgEngine engine, const pgRankOptions *options,
+					  pgResult *results, int maxResults, int *numResults,
+					  int *numIt)
+{
+	pgRankOptions opts;
+	if (options == NULL)
+	{
+		pgRankDefaults(&opts);
+	}
+	else
+	{
+		opts = *options;
+	}
+	pgStatus status = checkResults(engine, results, maxResults, numResults);
+	if (status != PG_OK)
+	{
+		return status;
+	}
+	if (!validDamping(opts.damping))
+	{
+		return fail(engine, PG_ERR_ARGUMENT,
+					"damping factor %g is not from 0 to 1", opts.damping);
+	}
+	if (opts.solver < PG_JACOBI || opts.solver > PG_EXTRAPOLATED ||
+		opts.precision < PG_DOUBLE || opts.precision > PG_MIXED)
+	{
+		return fail(engine, PG_ERR_ARGUMENT, "invalid rank options");
+	}
+
+	struct fatalTrap trap;
+	if (setjmp(trap.env) != 0)
+	{
+		return failRank(engine, trap.message);
+	}
+	fatalSetTrap(&trap);
+	pageRank pg = engine->pg;
+	pgSetSolver(pg, opts.solver);
+	pgSetPrecision(pg, opts.precision);
+	pgSetMemoryCap(pg, opts.memoryCap);
+	pgSetWarmStart(pg, opts.warmStart);
+	int it = rankCalculator(pg, opts.damping, opts.minDiff,
+							opts.maxIt);
+	*numResults = storeResults(pg, results, maxResults);
+	fatalClearTrap(&trap);
+	if (numIt != NULL)
+	{
+		*numIt = it;
+	}
+	return PG_OK;
+}
+
+pgStatus pgEngineRankBatch(pgEngine engine, const pgRankOptions *options,
+						   const double *dampings, int numDampings,
+						   pgResult *results, int maxResults, int *numResults,
+						   int *numIt)
+{
+	pgRankOptions opts;
+	if (options == NULL)
+	{
+		pgRankDefaults(&opts);
+	}
+	else
+	{
+		opts = *options;
+	}
+	pgStatus status = checkResults(engine, results, maxResults, numResults);
+	if (status != PG_OK)
+	{
+		return status;
+	}
+	if (numDampings < 1 || dampings == NULL)
+	{
+		return fail(engine, PG_ERR_ARGUMENT, "no damping factors");
+	}
+	for (int v = 0; v < numDampings; v++)
+	{
+		if (!validDamping(dampings[v]))
+		{
+			return fail(engine, PG_ERR_ARGUMENT,
+						"damping factor %g is not from 0 to 1", dampings[v]);
+		}
+	}
+
+	// the weight arrays are freed if a fatal error interrupts the batch
+	double **volatile weights = NULL;
+	int *volatile it = NULL;
+	struct fatalTrap trap;
+	if (setjmp(trap.env) != 0)
+	{
+		for (int v = 0; weights != NULL && v < numDampings; v++)
+		{
+			free(weights[v]);
+		}
+		free(weights);
+		free(it);
+		return failRank(engine, trap.message);
+	}
+	fatalSetTrap(&trap);
+	pageRank pg = engine->pg;
+	int numPages = pgNumPages(pg);
+	it = fatalAllocate(numDampings * sizeof(int));
+	double **w = fatalAllocate(numDampings * sizeof(double *));
+	for (int v = 0; v < numDampings; v++)
+	{
+		w[v] = NULL;
+	}
+	weights = w;
+	for (int v = 0; v < numDampings; v++)
+	{
+		weights[v] = fatalAllocate((numPages + 1) * sizeof(double));
+	}
+	rankCalculatorBatch(pg, numDampings, dampings, NULL, opts.minDiff,
+						opts.maxIt, weights, it);
+	for (int v = 0; v < numDampings; v++)
+	{
+		pgSetWeights(pg, weights[v]);
+		*numResults = storeResults(pg, &results[(size_t)v * maxResults],
+								   maxResults);
+		if (numIt != NULL)
+		{
+			numIt[v] = it[v];
+		}
+	}
+	fatalClearTrap(&trap);
+	for (int v = 0; v < numDampings; v++)
+	{
+		free(weights[v]);
+	}
+	free(weights);
+	free(it);
+	return PG_OK;
+}
+
+const char *pgEngineError(pgEngine engine)
+{
+	return engine->error;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Checks that a collection is loaded and that the results can be stored.
+static pgStatus checkResults(pgEngine engine, pgResult *results,
+							int maxResults, int *numResults)
+{
+	if (engine->pg == NULL)
+	{
+		return fail(engine, PG_ERR_ARGUMENT, "no collection is loaded");
+	}
+	if (maxResults < 0 || (results == NULL && maxResults > 0) ||
+		numResults == NULL)
+	{
+		return fail(engine, PG_ERR_ARGUMENT, "invalid result buffer");
+	}
+	return PG_OK;
+}
+
+// Whether damping is a damping factor, from 0 to 1 and not NaN.
+static bool validDamping(double damping)
+{
+	return damping >= 0.0 && damping <= 1.0;
+}
+
+// Stores the first maxResults pages in the order of orderUrls in results.
+// Returns the number stored.
+static int storeResults(pageRank pg, pgResult *results, int maxResults)
+{
+	int k = maxResults < pgNumPages(pg) ? maxResults : pgNumPages(pg);
+	const char **urls = fatalAllocate((k + 1) * sizeof(char *));
+	int *outDegrees = fatalAllocate((k + 1) * sizeof(int));
+	double *weights = fatalAllocate((k + 1) * sizeof(double));
+	k = pgTopPages(pg, k, urls, outDegrees, weights);
+	for (int i = 0; i < k; i++)
+	{
+		results[i].url = urls[i];
+		results[i].outDegree = outDegrees[i];
+		results[i].weight = weights[i];
+	}
+	free(urls);
+	free(outDegrees);
+	free(weights);
+	return k;
+}
+
+// Reports a fatal error that interrupted ranking. The graph is left whole
+// and kept, unless the out-of-core engine could not read its out-links
+// back from the edge file, in which case it is freed.
+static pgStatus failRank(pgEngine engine, const char *message)
+{
+	pageRank pg = engine->pg;
+	if (!pg->outLinksValid && !pg->listsValid)
+	{
+		pgFree(pg);
+		engine->pg = NULL;
+	}
+	return fail(engine, PG_ERR_FATAL, "%s", message);
+}
+
+// Describes a failure of the engine, as printf would, and returns status.
+static pgStatus fail(pgEngine engine, pgStatus status, const char *format,
+					 ...)
+{
+	va_list args;
+	va_start(args, format);
+	vsnprintf(engine->error, sizeof(engine->error), format, args);
+	va_end(args);
+	return status;
+}
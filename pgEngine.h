@@ -0,0 +1,138 @@
+// The interface of libpagerank, for programs that rank pages in-process
+// instead of running pageRank and parsing its output.
+//
+// An engine loads a collection once and can then rank it any number of
+// times, with any parameters. Results go to buffers the caller provides.
+// The library never prints and never ends the process: every function
+// that can fail returns a status, and pgEngineError describes the last
+// failure. An engine must only be used by one thread at a time, but
+// separate engines can be used by separate threads. The timings and
+// counters of stats.h are kept for the whole process, not per engine, so
+// they are only meaningful while one engine at a time is ranking.
+
+#ifndef PG_ENGINE_H
+#define PG_ENGINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "graph.h"
+
+typedef struct pgEngine *pgEngine;
+
+/**
+ * The outcome of an engine call.
+ * PG_OK            the call succeeded
+ * PG_ERR_ARGUMENT  an argument is out of range, or no collection has been loaded
+ * PG_ERR_LOAD      a file of the collection is missing or malformed
+ * PG_ERR_FATAL     memory, a thread or a temporary file could not be had, and some memory may
+ *                  be lost. A failed load leaves no collection loaded; a failed ranking keeps
+ *                  the collection, unless the out-of-core engine could not restore its links
+ **/
+typedef enum
+{
+	PG_OK,
+	PG_ERR_ARGUMENT,
+	PG_ERR_LOAD,
+	PG_ERR_FATAL,
+} pgStatus;
+
+/**
+ * How pgEngineLoad loads a collection. pgLoadDefaults sets every field.
+ **/
+typedef struct
+{
+	int numThreads;			  // threads for parsing and ranking, at least 1
+	const char *snapshotPath; // a snapshot to load from or save to, or NULL
+	pgOrdering ordering;	  // how to renumber the pages after loading
+} pgLoadOptions;
+
+/**
+ * How pgEngineRank ranks the pages. pgRankDefaults sets every field to the values pageRank
+ * is usually run with.
+ **/
+typedef struct
+{
+	double damping;		   // the damping factor, from 0 to 1
+	double minDiff;		   // the difference at which the iterations stop
+	int maxIt;			   // the maximum number of iterations
+	pgSolver solver;	   // as for pgSetSolver
+	pgPrecision precision; // as for pgSetPrecision
+	size_t memoryCap;	   // as for pgSetMemoryCap
+	bool warmStart;		   // as for pgSetWarmStart
+} pgRankOptions;
+
+/**
+ * A ranked page. The URL belongs to the engine, and stays valid until the engine loads another
+ * collection or is freed.
+ **/
+typedef struct
+{
+	const char *url;
+	int outDegree;
+	double weight;
+} pgResult;
+
+/**
+ * Creates an engine with no collection loaded. Returns NULL if there is no memory.
+ **/
+pgEngine pgEngineNew(void);
+
+/**
+ * Frees an engine and the collection it has loaded.
+ **/
+void pgEngineFree(pgEngine engine);
+
+/**
+ * Sets options to the defaults: one thread, no snapshot and no renumbering.
+ **/
+void pgLoadDefaults(pgLoadOptions *options);
+
+/**
+ * Sets options to the defaults: damping 0.85, minDiff 0.00001, maxIt 1000, the Jacobi
+ * solver in double precision, no memory cap and no warm start.
+ **/
+void pgRankDefaults(pgRankOptions *options);
+
+/**
+ * Loads the collection in dir, as pageRank does, in place of any collection the engine has
+ * loaded before, and calculates the Win and Wout values. If options->snapshotPath is set, the
+ * snapshot is used when it is up to date, and otherwise rebuilt; failing to write it is not an
+ * error. options may be NULL for the defaults.
+ **/
+pgStatus pgEngineLoad(pgEngine engine, const char *dir,
+					  const pgLoadOptions *options);
+
+/**
+ * Returns the number of pages of the loaded collection, or 0 if there is none.
+ **/
+int pgEngineNumPages(pgEngine engine);
+
+/**
+ * Ranks the pages of the loaded collection and stores the first maxResults of them, in the
+ * order pageRank prints them, in results. Stores the number of results in *numResults and, if
+ * numIt is not NULL, the number of iterations in *numIt. options may be NULL for the defaults.
+ **/
+pgStatus pgEngineRank(pgEngine engine, const pgRankOptions *options,
+					  pgResult *results, int maxResults, int *numResults,
+					  int *numIt);
+
+/**
+ * Ranks the pages once for each of the numDampings damping factors, in one batched calculation
+ * (see rankCalculatorBatch), with minDiff and maxIt from options; its other fields are ignored.
+ * The results of dampings[v] are stored from results[v * maxResults], and if numIt is not NULL,
+ * its number of iterations in numIt[v]. Stores the number of results of each damping factor in
+ * *numResults.
+ **/
+pgStatus pgEngineRankBatch(pgEngine engine, const pgRankOptions *options,
+						   const double *dampings, int numDampings,
+						   pgResult *results, int maxResults, int *numResults,
+						   int *numIt);
+
+/**
+ * Returns a description of the last failure of the engine, or "" if it has not failed. The
+ * string belongs to the engine and changes with its next failure.
+ **/
+const char *pgEngineError(pgEngine engine);
+
+#endif
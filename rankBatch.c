@@ -0,0 +1,318 @@
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fatal.h"
+#include "graph.h"
+#include "graphPrivate.h"
+#include "rankBatch.h"
+#include "rankKernel.h"
+#include "stats.h"
+
+// The rows of the interleaved weights are padded with zeros to a multiple
+// of this many vectors, which are summed together with the sums kept in
+// registers.
+#define BATCH_LANES 4
+
+// A batched calculation shared by its workers. Vectors are referred to by
+// their index v in the caller's arrays; active lists the vectors still
+// iterating, and x holds their last weights interleaved, the weight of
+// vector active[u] for page i at x[i * rowSize(numActive) + u].
+struct batchJob
+{
+	pageRank pg;
+	const double *dampings;
+	const double *const *teleports;
+	double minDiff;		 // the difference at which a vector stops
+	int maxIt;			 // the maximum number of iterations
+	int numIt;			 // the number of iterations done so far
+	double **results;	 // where the weights of each vector go
+	int *resultIt;		 // where the iterations of each vector go
+	double **weights;	 // the new weights of each vector
+	double **oldWeights; // the last weights of each vector
+	double *x;			 // the weights read through the in-links
+	int *active;		 // the vectors still iterating
+	int numActive;		 // the number of vectors still iterating
+	bool done;			 // whether the workers should stop iterating
+	int numWorkers;		 // the number of workers sharing the calculation
+	struct batchWorker *workers;
+	pthread_barrier_t barrier;
+};
+
+struct batchWorker
+{
+	struct batchJob *job;
+	int start;	   // the first page updated by this worker
+	int end;	   // one past the last page updated by this worker
+	double *sums;  // the raw weightings of one page, one per vector
+	double *diffs; // the weight difference of its pages, one per vector
+};
+
+static void *batchWorkerRun(void *arg);
+static void sumInLinks(struct batchWorker *w);
+static double finishVector(struct batchJob *job, int v, int start, int end);
+static void retireVectors(struct batchJob *job);
+static void interleave(struct batchWorker *w);
+static int rowSize(int numVectors);
+static double *allocateRows(size_t size);
+
+////////////////////////////////////////////////////////////////////////
+
+int rankCalculatorBatch(pageRank pg, int numVectors, const double *dampings,
+						const double *const *teleports, double minDiff,
+						int maxIt, double **weights, int *numIt)
+{
+	int n = pg->numPages;
+	for (int v = 0; v < numVectors; v++)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			weights[v][i] = 1.0 / n;
+		}
+		numIt[v] = 0;
+	}
+	if (maxIt <= 0 || n == 0 || numVectors <= 0)
+	{
+		return 0;
+	}
+	pgCompileInCoefficients(pg);
+
+	struct batchJob job;
+	job.pg = pg;
+	job.dampings = dampings;
+	job.teleports = teleports;
+	job.minDiff = minDiff;
+	job.maxIt = maxIt;
+	job.numIt = 0;
+	job.results = weights;
+	job.resultIt = numIt;
+	job.weights = fatalAllocate(numVectors * sizeof(double *));
+	job.oldWeights = fatalAllocate(numVectors * sizeof(double *));
+	job.x = allocateRows((size_t)n * rowSize(numVectors));
+	job.active = fatalAllocate(numVectors * sizeof(int));
+	job.numActive = numVectors;
+	job.done = false;
+	for (int v = 0; v < numVectors; v++)
+	{
+		job.weights[v] = fatalAllocate(n * sizeof(double));
+		job.oldWeights[v] = fatalAllocate(n * sizeof(double));
+		memcpy(job.oldWeights[v], weights[v], n * sizeof(double));
+		job.active[v] = v;
+	}
+
+	// the same split as rankCalculator's workers, so that the differences
+	// of each vector are added up the same way
+	job.numWorkers = pg->numThreads < n ? pg->numThreads : n;
+	job.workers = fatalAllocate(job.numWorkers * sizeof(struct batchWorker));
+	int *starts = fatalAllocate((job.numWorkers + 1) * sizeof(int));
+	pgPartitionPages(pg->inOffsets, n, starts, job.numWorkers);
+	for (int t = 0; t < job.numWorkers; t++)
+	{
+		job.workers[t].job = &job;
+		job.workers[t].start = starts[t];
+		job.workers[t].end = starts[t + 1];
+		job.workers[t].sums =
+			fatalAllocate(rowSize(numVectors) * sizeof(double));
+		job.workers[t].diffs = fatalAllocate(numVectors * sizeof(double));
+	}
+	free(starts);
+	for (int t = 0; t < job.numWorkers; t++)
+	{
+		interleave(&job.workers[t]);
+	}
+	pthread_barrier_init(&job.barrier, NULL, job.numWorkers);
+	pgRunWorkers(job.numWorkers, batchWorkerRun, job.workers,
+				 sizeof(struct batchWorker));
+	pthread_barrier_destroy(&job.barrier);
+	for (int t = 0; t < job.numWorkers; t++)
+	{
+		free(job.workers[t].sums);
+		free(job.workers[t].diffs);
+	}
+	for (int v = 0; v < numVectors; v++)
+	{
+		free(job.weights[v]);
+		free(job.oldWeights[v]);
+	}
+	free(job.workers);
+	free(job.weights);
+	free(job.oldWeights);
+	free(job.x);
+	free(job.active);
+	pgCompileOutLinks(pg);
+	statsSet(STAT_PAGES, n);
+	statsSet(STAT_LINKS, pg->outOffsets[n]);
+	statsCount(STAT_ITERATIONS, job.numIt);
+	return job.numIt;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Runs one worker's share of every iteration until all the vectors have
+// stopped.
+static void *batchWorkerRun(void *arg)
+{
+	struct batchWorker *w = arg;
+	struct batchJob *job = w->job;
+	while (true)
+	{
+		sumInLinks(w);
+		for (int u = 0; u < job->numActive; u++)
+		{
+			w->diffs[u] =
+				finishVector(job, job->active[u], w->start, w->end);
+		}
+		pthread_barrier_wait(&job->barrier);
+
+		if (w == &job->workers[0])
+		{
+			retireVectors(job);
+		}
+		pthread_barrier_wait(&job->barrier);
+
+		if (job->done)
+		{
+			return NULL;
+		}
+		// no worker reads x until every worker has rewritten its part
+		interleave(w);
+		pthread_barrier_wait(&job->barrier);
+	}
+}
+
+// Stores the raw weighting of each of the worker's pages in the new
+// weights of every active vector. The in-links of a page are read once,
+// and the sums are added up in the same order as rawWeightingCalc.
+static void sumInLinks(struct batchWorker *w)
+{
+	struct batchJob *job = w->job;
+	pageRank pg = job->pg;
+	int k = job->numActive;
+	int size = rowSize(k);
+	double *sums = w->sums;
+	for (int i = w->start; i < w->end; i++)
+	{
+		// a group of vectors at a time, so that the sums stay in registers;
+		// after the first group the page's in-links are read from cache
+		for (int u = 0; u < size; u += BATCH_LANES)
+		{
+			double sum[BATCH_LANES] = {0.0};
+			for (int j = pg->inOffsets[i]; j < pg->inOffsets[i + 1]; j++)
+			{
+				const double *x = &job->x[(size_t)pg->inLinks[j] * size + u];
+				double coeff = pg->inCoeff[j];
+				for (int l = 0; l < BATCH_LANES; l++)
+				{
+					sum[l] += x[l] * coeff;
+				}
+			}
+			for (int l = 0; l < BATCH_LANES; l++)
+			{
+				sums[u + l] = sum[l];
+			}
+		}
+		for (int u = 0; u < k; u++)
+		{
+			job->weights[job->active[u]][i] = sums[u];
+		}
+	}
+}
+
+// Applies the damping factor and the jump of vector v to its raw
+// weightings of pages start to end - 1, and returns the difference from
+// its last weights over those pages.
+static double finishVector(struct batchJob *job, int v, int start, int end)
+{
+	double damping = job->dampings[v];
+	double *weights = job->weights[v];
+	const double *oldWeights = job->oldWeights[v];
+	if (job->teleports == NULL || job->teleports[v] == NULL)
+	{
+		double constant = (1.0 - damping) / job->pg->numPages;
+		return rankUpdate(&weights[start], &oldWeights[start], end - start,
+						  damping, constant);
+	}
+	const double *teleport = job->teleports[v];
+	double diff = 0.0;
+	for (int i = start; i < end; i++)
+	{
+		weights[i] = weights[i] * damping + (1.0 - damping) * teleport[i];
+		diff += fabs(weights[i] - oldWeights[i]);
+	}
+	return diff;
+}
+
+// Ends an iteration: hands the vectors that have converged or run out of
+// iterations back to the caller and drops them from the active list.
+static void retireVectors(struct batchJob *job)
+{
+	int n = job->pg->numPages;
+	job->numIt++;
+	int numActive = 0;
+	for (int u = 0; u < job->numActive; u++)
+	{
+		int v = job->active[u];
+		double currDiff = 0.0;
+		for (int t = 0; t < job->numWorkers; t++)
+		{
+			currDiff += job->workers[t].diffs[u];
+		}
+		if (job->numIt >= job->maxIt || currDiff < job->minDiff)
+		{
+			memcpy(job->results[v], job->weights[v], n * sizeof(double));
+			job->resultIt[v] = job->numIt;
+		}
+		else
+		{
+			double *temp = job->oldWeights[v];
+			job->oldWeights[v] = job->weights[v];
+			job->weights[v] = temp;
+			job->active[numActive++] = v;
+		}
+	}
+	job->numActive = numActive;
+	job->done = numActive == 0;
+}
+
+// Copies the last weights of the active vectors for the worker's pages
+// into x, interleaved for the next iteration.
+static void interleave(struct batchWorker *w)
+{
+	struct batchJob *job = w->job;
+	int k = job->numActive;
+	int size = rowSize(k);
+	for (int i = w->start; i < w->end; i++)
+	{
+		double *x = &job->x[(size_t)i * size];
+		for (int u = 0; u < k; u++)
+		{
+			x[u] = job->oldWeights[job->active[u]][i];
+		}
+		for (int u = k; u < size; u++)
+		{
+			x[u] = 0.0;
+		}
+	}
+}
+
+// Returns the padded size of a row of x for numVectors vectors.
+static int rowSize(int numVectors)
+{
+	return (numVectors + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+}
+
+// Allocates an array of size weights aligned to a cache line, so that a
+// row of x spans as few cache lines as it can.
+static double *allocateRows(size_t size)
+{
+	void *rows;
+	if (posix_memalign(&rows, 64, size * sizeof(double)) != 0)
+	{
+		fatalError("out of memory");
+	}
+	return rows;
+}
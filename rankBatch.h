@@ -0,0 +1,27 @@
+#ifndef RANK_BATCH_H
+#define RANK_BATCH_H
+
+#include "graph.h"
+
+// Runs rankCalculator's Jacobi iterations for numVectors weight vectors
+// at once, one for each of the given damping factors, so that each
+// iteration reads the in-link index once for all of them. The vectors
+// are kept interleaved page by page while the in-links are read. Each
+// vector stops on its own once its difference is below minDiff or it has
+// done maxIt iterations, and the rest carry on without it.
+//
+// If teleports is not NULL and teleports[v] is not NULL, vector v jumps
+// to page i with probability teleports[v][i] (the values should add up
+// to 1) instead of to every page alike. Vectors with the uniform jump end
+// with exactly the weights and iterations of rankCalculator with the
+// same damping factor and number of threads, the Jacobi solver and
+// double precision. Always runs in memory, whatever the memory cap.
+//
+// Writes the numPages weights of vector v to weights[v] and its number
+// of iterations to numIt[v]. Returns the number of iterations done, the
+// largest of numIt. Leaves the weights found by rankCalculator alone.
+int rankCalculatorBatch(pageRank pg, int numVectors, const double *dampings,
+						const double *const *teleports, double minDiff,
+						int maxIt, double **weights, int *numIt);
+
+#endif
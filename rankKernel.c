@@ -0,0 +1,221 @@
+#include <math.h>
+#include <stdlib.h>
+
+#include "rankKernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RANK_KERNEL_X86
+#endif
+
+static double rankUpdateScalar(double *weights, const double *oldWeights,
+							   int n, double damping, double constant);
+static double rankUpdateFloatScalar(float *weights, const float *oldWeights,
+									int n, float damping, float constant,
+									double *total);
+#ifdef RANK_KERNEL_X86
+static double rankUpdateSse2(double *weights, const double *oldWeights,
+							 int n, double damping, double constant);
+static double rankUpdateAvx2(double *weights, const double *oldWeights,
+							 int n, double damping, double constant);
+static double rankUpdateFloatSse2(float *weights, const float *oldWeights,
+								  int n, float damping, float constant,
+								  double *total);
+static double rankUpdateFloatAvx2(float *weights, const float *oldWeights,
+								  int n, float damping, float constant,
+								  double *total);
+#endif
+
+////////////////////////////////////////////////////////////////////////
+
+double rankUpdate(double *weights, const double *oldWeights, int n,
+				  double damping, double constant)
+{
+#ifdef RANK_KERNEL_X86
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return rankUpdateAvx2(weights, oldWeights, n, damping, constant);
+	}
+	if (__builtin_cpu_supports("sse2"))
+	{
+		return rankUpdateSse2(weights, oldWeights, n, damping, constant);
+	}
+#endif
+	return rankUpdateScalar(weights, oldWeights, n, damping, constant);
+}
+
+double rankUpdateFloat(float *weights, const float *oldWeights, int n,
+					   float damping, float constant, double *total)
+{
+#ifdef RANK_KERNEL_X86
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return rankUpdateFloatAvx2(weights, oldWeights, n, damping, constant,
+								   total);
+	}
+	if (__builtin_cpu_supports("sse2"))
+	{
+		return rankUpdateFloatSse2(weights, oldWeights, n, damping, constant,
+								   total);
+	}
+#endif
+	return rankUpdateFloatScalar(weights, oldWeights, n, damping, constant,
+								 total);
+}
+
+static double rankUpdateScalar(double *weights, const double *oldWeights,
+							   int n, double damping, double constant)
+{
+	double diff = 0.0;
+	for (int i = 0; i < n; i++)
+	{
+		double weight = weights[i] * damping + constant;
+		weights[i] = weight;
+		diff += fabs(weight - oldWeights[i]);
+	}
+	return diff;
+}
+
+static double rankUpdateFloatScalar(float *weights, const float *oldWeights,
+									int n, float damping, float constant,
+									double *total)
+{
+	double diff = 0.0;
+	double sum = 0.0;
+	for (int i = 0; i < n; i++)
+	{
+		float weight = weights[i] * damping + constant;
+		weights[i] = weight;
+		diff += fabs((double)weight - oldWeights[i]);
+		sum += weight;
+	}
+	*total = sum;
+	return diff;
+}
+
+#ifdef RANK_KERNEL_X86
+
+__attribute__((target("sse2"))) static double
+rankUpdateSse2(double *weights, const double *oldWeights, int n,
+			   double damping, double constant)
+{
+	__m128d d = _mm_set1_pd(damping);
+	__m128d c = _mm_set1_pd(constant);
+	__m128d signMask = _mm_set1_pd(-0.0);
+	__m128d sum = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 2 <= n; i += 2)
+	{
+		__m128d w = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(&weights[i]), d), c);
+		_mm_storeu_pd(&weights[i], w);
+		__m128d delta = _mm_sub_pd(w, _mm_loadu_pd(&oldWeights[i]));
+		sum = _mm_add_pd(sum, _mm_andnot_pd(signMask, delta));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, sum);
+	return lanes[0] + lanes[1] +
+		   rankUpdateScalar(&weights[i], &oldWeights[i], n - i, damping,
+							constant);
+}
+
+__attribute__((target("avx2"))) static double
+rankUpdateAvx2(double *weights, const double *oldWeights, int n,
+			   double damping, double constant)
+{
+	__m256d d = _mm256_set1_pd(damping);
+	__m256d c = _mm256_set1_pd(constant);
+	__m256d signMask = _mm256_set1_pd(-0.0);
+	__m256d sum = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m256d w =
+			_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&weights[i]), d), c);
+		_mm256_storeu_pd(&weights[i], w);
+		__m256d delta = _mm256_sub_pd(w, _mm256_loadu_pd(&oldWeights[i]));
+		sum = _mm256_add_pd(sum, _mm256_andnot_pd(signMask, delta));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, sum);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+		   rankUpdateScalar(&weights[i], &oldWeights[i], n - i, damping,
+							constant);
+}
+
+// The single precision kernels widen each group of new weights to double
+// before adding them up, so long sums do not lose precision.
+
+__attribute__((target("sse2"))) static double
+rankUpdateFloatSse2(float *weights, const float *oldWeights, int n,
+					float damping, float constant, double *total)
+{
+	__m128 d = _mm_set1_ps(damping);
+	__m128 c = _mm_set1_ps(constant);
+	__m128d signMask = _mm_set1_pd(-0.0);
+	__m128d diffSum = _mm_setzero_pd();
+	__m128d weightSum = _mm_setzero_pd();
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128 w = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&weights[i]), d), c);
+		_mm_storeu_ps(&weights[i], w);
+		__m128 old = _mm_loadu_ps(&oldWeights[i]);
+		__m128d wLow = _mm_cvtps_pd(w);
+		__m128d wHigh = _mm_cvtps_pd(_mm_movehl_ps(w, w));
+		__m128d deltaLow = _mm_sub_pd(wLow, _mm_cvtps_pd(old));
+		__m128d deltaHigh =
+			_mm_sub_pd(wHigh, _mm_cvtps_pd(_mm_movehl_ps(old, old)));
+		diffSum = _mm_add_pd(diffSum, _mm_andnot_pd(signMask, deltaLow));
+		diffSum = _mm_add_pd(diffSum, _mm_andnot_pd(signMask, deltaHigh));
+		weightSum = _mm_add_pd(weightSum, _mm_add_pd(wLow, wHigh));
+	}
+	double diffs[2];
+	double sums[2];
+	_mm_storeu_pd(diffs, diffSum);
+	_mm_storeu_pd(sums, weightSum);
+	double rest;
+	double diff = rankUpdateFloatScalar(&weights[i], &oldWeights[i], n - i,
+										damping, constant, &rest);
+	*total = sums[0] + sums[1] + rest;
+	return diffs[0] + diffs[1] + diff;
+}
+
+__attribute__((target("avx2"))) static double
+rankUpdateFloatAvx2(float *weights, const float *oldWeights, int n,
+					float damping, float constant, double *total)
+{
+	__m256 d = _mm256_set1_ps(damping);
+	__m256 c = _mm256_set1_ps(constant);
+	__m256d signMask = _mm256_set1_pd(-0.0);
+	__m256d diffSum = _mm256_setzero_pd();
+	__m256d weightSum = _mm256_setzero_pd();
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+	{
+		__m256 w =
+			_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(&weights[i]), d), c);
+		_mm256_storeu_ps(&weights[i], w);
+		__m256 old = _mm256_loadu_ps(&oldWeights[i]);
+		__m256d wLow = _mm256_cvtps_pd(_mm256_castps256_ps128(w));
+		__m256d wHigh = _mm256_cvtps_pd(_mm256_extractf128_ps(w, 1));
+		__m256d deltaLow = _mm256_sub_pd(
+			wLow, _mm256_cvtps_pd(_mm256_castps256_ps128(old)));
+		__m256d deltaHigh = _mm256_sub_pd(
+			wHigh, _mm256_cvtps_pd(_mm256_extractf128_ps(old, 1)));
+		diffSum = _mm256_add_pd(diffSum, _mm256_andnot_pd(signMask, deltaLow));
+		diffSum =
+			_mm256_add_pd(diffSum, _mm256_andnot_pd(signMask, deltaHigh));
+		weightSum = _mm256_add_pd(weightSum, _mm256_add_pd(wLow, wHigh));
+	}
+	double diffs[4];
+	double sums[4];
+	_mm256_storeu_pd(diffs, diffSum);
+	_mm256_storeu_pd(sums, weightSum);
+	double rest;
+	double diff = rankUpdateFloatScalar(&weights[i], &oldWeights[i], n - i,
+										damping, constant, &rest);
+	*total = (sums[0] + sums[1]) + (sums[2] + sums[3]) + rest;
+	return (diffs[0] + diffs[1]) + (diffs[2] + diffs[3]) + diff;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef RANK_KERNEL_H
+#define RANK_KERNEL_H
+
+// Finishes one iteration for n pages in a single pass. On entry
+// weights[i] holds the raw weighting of page i; on return it holds
+// damping * weights[i] + constant. Returns the sum of the differences
+// |weights[i] - oldWeights[i]| of the new weights.
+// Uses AVX2 or SSE2 when the processor supports them.
+// Complexity: O(n)
+double rankUpdate(double *weights, const double *oldWeights, int n,
+				  double damping, double constant);
+
+// The same as rankUpdate for single precision weights. The differences
+// are added up in double precision, and the sum of the new weights is
+// stored in *total.
+// Complexity: O(n)
+double rankUpdateFloat(float *weights, const float *oldWeights, int n,
+					   float damping, float constant, double *total);
+
+#endif
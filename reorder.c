@@ -0,0 +1,196 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fatal.h"
+#include "reorder.h"
+
+// A page and its degree, for sorting the pages found by the search.
+struct pageDegree
+{
+	int degree;
+	int page;
+};
+
+static int comparePageDegrees(const void *a, const void *b);
+
+////////////////////////////////////////////////////////////////////////
+
+void orderByDegree(const int *degree, int numPages, int *order)
+{
+	int maxDegree = 0;
+	for (int i = 0; i < numPages; i++)
+	{
+		if (degree[i] > maxDegree)
+		{
+			maxDegree = degree[i];
+		}
+	}
+
+	// a counting sort, so that ties stay in id order; start[d] becomes
+	// the position of the first page of degree d
+	int *start = fatalAllocate((maxDegree + 2) * sizeof(int));
+	for (int d = 0; d <= maxDegree + 1; d++)
+	{
+		start[d] = 0;
+	}
+	for (int i = 0; i < numPages; i++)
+	{
+		start[degree[i]]++;
+	}
+	int position = 0;
+	for (int d = maxDegree; d >= 0; d--)
+	{
+		int count = start[d];
+		start[d] = position;
+		position += count;
+	}
+	for (int i = 0; i < numPages; i++)
+	{
+		order[start[degree[i]]++] = i;
+	}
+	free(start);
+}
+
+void orderByHubs(const int *outOffsets, const int *outLinks,
+				 const int *inOffsets, const int *inLinks, int numPages,
+				 int *order)
+{
+	int *degree = fatalAllocate((numPages + 1) * sizeof(int));
+	int *byDegree = fatalAllocate((numPages + 1) * sizeof(int));
+	bool *placed = fatalAllocate((numPages + 1) * sizeof(bool));
+	for (int i = 0; i < numPages; i++)
+	{
+		degree[i] = outOffsets[i + 1] - outOffsets[i];
+		placed[i] = false;
+	}
+	orderByDegree(degree, numPages, byDegree);
+
+	// a page is a hub if degree * numPages > numLinks, which avoids
+	// rounding the average; the hubs lead byDegree
+	long numLinks = outOffsets[numPages];
+	int numHubs = 0;
+	while (numHubs < numPages &&
+		   (long)degree[byDegree[numHubs]] * numPages > numLinks)
+	{
+		placed[byDegree[numHubs]] = true;
+		numHubs++;
+	}
+	int position = 0;
+	for (int h = 0; h < numHubs; h++)
+	{
+		int hub = byDegree[h];
+		order[position++] = hub;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			const int *offsets = pass == 0 ? outOffsets : inOffsets;
+			const int *links = pass == 0 ? outLinks : inLinks;
+			for (int j = offsets[hub]; j < offsets[hub + 1]; j++)
+			{
+				if (!placed[links[j]])
+				{
+					placed[links[j]] = true;
+					order[position++] = links[j];
+				}
+			}
+		}
+	}
+	for (int i = 0; i < numPages; i++)
+	{
+		if (!placed[i])
+		{
+			order[position++] = i;
+		}
+	}
+	free(degree);
+	free(byDegree);
+	free(placed);
+}
+
+void orderByRcm(const int *outOffsets, const int *outLinks,
+				const int *inOffsets, const int *inLinks, int numPages,
+				int *order)
+{
+	struct pageDegree *byDegree =
+		fatalAllocate((numPages + 1) * sizeof(struct pageDegree));
+	struct pageDegree *found =
+		fatalAllocate((numPages + 1) * sizeof(struct pageDegree));
+	bool *visited = fatalAllocate((numPages + 1) * sizeof(bool));
+	for (int i = 0; i < numPages; i++)
+	{
+		byDegree[i].degree = (outOffsets[i + 1] - outOffsets[i]) +
+							 (inOffsets[i + 1] - inOffsets[i]);
+		byDegree[i].page = i;
+		visited[i] = false;
+	}
+	qsort(byDegree, numPages, sizeof(struct pageDegree), comparePageDegrees);
+
+	// order doubles as the search queue: pages are appended as they are
+	// found and taken from the front
+	int tail = 0;
+	int nextStart = 0;
+	for (int head = 0; head < numPages; head++)
+	{
+		if (head == tail)
+		{
+			// a new component, started from its page of the lowest degree
+			while (visited[byDegree[nextStart].page])
+			{
+				nextStart++;
+			}
+			order[tail++] = byDegree[nextStart].page;
+			visited[byDegree[nextStart].page] = true;
+		}
+
+		int v = order[head];
+		int numFound = 0;
+		for (int pass = 0; pass < 2; pass++)
+		{
+			const int *offsets = pass == 0 ? outOffsets : inOffsets;
+			const int *links = pass == 0 ? outLinks : inLinks;
+			for (int j = offsets[v]; j < offsets[v + 1]; j++)
+			{
+				int w = links[j];
+				if (!visited[w])
+				{
+					visited[w] = true;
+					found[numFound].degree =
+						(outOffsets[w + 1] - outOffsets[w]) +
+						(inOffsets[w + 1] - inOffsets[w]);
+					found[numFound].page = w;
+					numFound++;
+				}
+			}
+		}
+		qsort(found, numFound, sizeof(struct pageDegree), comparePageDegrees);
+		for (int k = 0; k < numFound; k++)
+		{
+			order[tail++] = found[k].page;
+		}
+	}
+
+	for (int i = 0, j = numPages - 1; i < j; i++, j--)
+	{
+		int temp = order[i];
+		order[i] = order[j];
+		order[j] = temp;
+	}
+	free(byDegree);
+	free(found);
+	free(visited);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Orders pages by increasing degree, then by increasing id.
+static int comparePageDegrees(const void *a, const void *b)
+{
+	const struct pageDegree *p = a;
+	const struct pageDegree *q = b;
+	if (p->degree != q->degree)
+	{
+		return p->degree < q->degree ? -1 : 1;
+	}
+	return (p->page > q->page) - (p->page < q->page);
+}
@@ -0,0 +1,37 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+// Orderings of the pages of a graph that place pages whose weights are
+// read together close together in memory. Each one fills order with a
+// permutation of the numPages pages: order[i] is the id of the page that
+// is to become page i. The graph is given as compressed sparse rows of
+// out-links and in-links.
+//
+// An iteration reads the weight of a page once for each of its out-links,
+// so the degree based orderings are meant to be given the out-degrees.
+
+// Sorts the pages by decreasing degree, keeping pages of the same degree
+// in id order, so the most read weights share cache lines.
+// Complexity: O(n + maxDegree)
+void orderByDegree(const int *degree, int numPages, int *order);
+
+// Hub clustering: takes the hubs, the pages with more out-links than the
+// average, by decreasing out-degree, and places each one followed by the
+// pages it links to and the pages that link to it that are not hubs and
+// have not been placed yet. The pages left over follow in id order. Each
+// hub's weight is then read together with the weights of its neighbours.
+// Complexity: O(n + m) for m links
+void orderByHubs(const int *outOffsets, const int *outLinks,
+				 const int *inOffsets, const int *inLinks, int numPages,
+				 int *order);
+
+// Reverse Cuthill-McKee: a breadth-first search of the graph with the
+// link directions ignored, which visits the neighbours of each page in
+// increasing degree and starts each component from a page of the lowest
+// degree, reversed. Linked pages end up with nearby ids.
+// Complexity: O(n + m log m) for m links
+void orderByRcm(const int *outOffsets, const int *outLinks,
+				const int *inOffsets, const int *inLinks, int numPages,
+				int *order);
+
+#endif
@@ -0,0 +1,1078 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Map.h"
+#include "fatal.h"
+#include "fileUtil.h"
+#include "searchIndex.h"
+
+// Index layout: a header followed by the sections it points to, each
+// starting at a multiple of 8 bytes.
+//   buckets   int32_t[numBuckets]   the index in terms of the term hashed
+//                                   to each bucket, or -1 if it is empty,
+//                                   with collisions probed linearly
+//   terms     struct indexTerm[numTerms]
+//   skips     struct indexSkip[numSkips] one for each block of postings
+//   postings  uint8_t[postingsSize] the compressed postings of each term
+//   docs      int64_t[numDocs]      where each document's URL starts
+//   strings   char[stringsSize]     the null-terminated terms and URLs
+// Documents are numbered in the order of the order file, if there is one,
+// and then in the order they first appear in the text index.
+// The sorted postings of a term are split into blocks of POSTING_BLOCK.
+// The first document of a block is stored as a varint, and each of the
+// others as a varint of its difference from the one before: seven bits a
+// byte, lowest first, with the top bit set on all bytes but the last.
+#define INDEX_MAGIC "PGINDEX\n"
+#define INDEX_VERSION 3
+#define INDEX_BYTE_ORDER 0x01020304u
+#define POSTING_BLOCK 64
+
+_Static_assert(sizeof(int) == sizeof(int32_t), "the index needs 32-bit ints");
+
+struct indexTerm
+{
+	uint32_t hash;	  // the hash of the term, as hashTerm computes it
+	int32_t numPostings;
+	int64_t name;	  // where the term starts in strings
+	int64_t postings; // where its postings start in postings
+	int32_t skips;	  // where the skips of its blocks start in skips
+	int32_t maxCount; // the most times one document is listed for it
+};
+
+// Where a block of postings starts, and the last document in it.
+struct indexSkip
+{
+	int32_t lastDoc;
+	uint32_t offset; // from the start of the term's postings
+};
+
+struct indexHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;		 // INDEX_BYTE_ORDER as written by the builder
+	int64_t numBuckets;		 // a power of two, greater than numTerms
+	int64_t numTerms;
+	int64_t numSkips;
+	int64_t numPostings;
+	int64_t postingsSize;
+	int64_t numDocs;
+	int64_t stringsSize;
+	struct fileStamp source; // the text index it was built from
+	struct fileStamp order;	 // the order file, or a size of -1 if none
+	int64_t bucketsAt;		 // where each section starts in the file
+	int64_t termsAt;
+	int64_t skipsAt;
+	int64_t postingsAt;
+	int64_t docsAt;
+	int64_t stringsAt;
+	int64_t size;			 // the size of the whole file
+};
+
+struct searchIndex
+{
+	char *base;	 // the mapped file, or the index built in memory
+	size_t size; // the size of the index
+	bool mapped; // whether base is mapped rather than allocated
+	struct indexHeader *h;
+	int32_t *buckets;
+	struct indexTerm *terms;
+	struct indexSkip *skips;
+	uint8_t *postings;
+	int64_t *docs;
+	char *strings;
+};
+
+struct postingList
+{
+	const uint8_t *data;		   // the term's compressed postings
+	const uint8_t *end;			   // the end of the postings section
+	const struct indexSkip *skips; // the term's skips
+	int numPostings;
+	int maxCount;				   // the most times one document is listed
+	int numBlocks;
+	int block;					   // the decoded block
+	int blockSize;				   // the number of postings in it
+	int pos;					   // the current posting in the block
+	int docs[POSTING_BLOCK];	   // the documents of the decoded block
+};
+
+// A document and the number of postings it has in the lists of a query.
+struct scoredDoc
+{
+	int doc;
+	int count;
+};
+
+// A growable array of bytes.
+struct buffer
+{
+	char *data;
+	size_t size;
+	size_t capacity;
+};
+
+// The text index as it is parsed: the terms and documents found so far,
+// and for each posting, the term and the document, in the order read.
+struct indexBuilder
+{
+	Map termIds;
+	Map docIds;
+	struct buffer strings;	 // the terms' and documents' names
+	struct buffer termNames; // int64_t: where each term starts in strings
+	struct buffer docNames;	 // int64_t: where each URL starts in strings
+	struct buffer pairTerms; // int32_t: the term of each posting
+	struct buffer pairDocs;	 // int32_t: the document of each posting
+};
+
+static bool mapIndex(searchIndex index, const char *path,
+					 struct fileStamp *source, struct fileStamp *order);
+static char *buildIndex(const char *textPath, const char *orderPath,
+						size_t *size);
+static void parseOrder(struct indexBuilder *b, const char *p,
+					   const char *end);
+static void parseLines(struct indexBuilder *b, const char *p,
+					   const char *end);
+static int32_t findOrAdd(struct indexBuilder *b, Map ids,
+						 struct buffer *names, struct token *t);
+static char *layOut(struct indexBuilder *b, struct fileStamp *source,
+					struct fileStamp *order, size_t *size);
+static int compressPostings(int32_t *docs, int n, struct buffer *stream,
+							struct buffer *skips);
+static void decodeBlock(postingList l, int b);
+static bool dropsBefore(struct scoredDoc *a, struct scoredDoc *b);
+static void siftUp(struct scoredDoc *heap, int i);
+static void siftDown(struct scoredDoc *heap, int size, int i);
+static int compareScores(const void *a, const void *b);
+static void appendVarint(struct buffer *b, uint32_t value);
+static bool readVarint(const uint8_t **p, const uint8_t *end,
+					   uint32_t *value);
+static int compareDocs(const void *a, const void *b);
+static void saveIndex(const char *path, const char *image, size_t size);
+static bool validHeader(struct indexHeader *h, char *base, size_t size);
+static void setSections(searchIndex index);
+static uint32_t hashTerm(const char *term, size_t len);
+static void append(struct buffer *b, const void *data, size_t size);
+static int64_t align8(int64_t at);
+
+////////////////////////////////////////////////////////////////////////
+
+searchIndex searchIndexOpen(const char *textPath, const char *orderPath,
+							const char *path)
+{
+	struct fileStamp source;
+	struct fileStamp order = {-1, 0, 0};
+	if (!stampFile(textPath, &source) ||
+		(orderPath != NULL && !stampFile(orderPath, &order)))
+	{
+		return NULL;
+	}
+	searchIndex index = fatalAllocate(sizeof(*index));
+	if (mapIndex(index, path, &source, &order))
+	{
+		return index;
+	}
+
+	index->base = buildIndex(textPath, orderPath, &index->size);
+	if (index->base == NULL)
+	{
+		free(index);
+		return NULL;
+	}
+	index->mapped = false;
+	saveIndex(path, index->base, index->size);
+	setSections(index);
+	return index;
+}
+
+void searchIndexFree(searchIndex index)
+{
+	if (index->mapped)
+	{
+		munmap(index->base, index->size);
+	}
+	else
+	{
+		free(index->base);
+	}
+	free(index);
+}
+
+postingList searchIndexFind(searchIndex index, const char *term)
+{
+	struct indexHeader *h = index->h;
+	uint32_t hash = hashTerm(term, strlen(term));
+	int64_t mask = h->numBuckets - 1;
+	int64_t i = hash & mask;
+	for (int64_t probes = 0; probes < h->numBuckets; probes++)
+	{
+		int32_t t = index->buckets[i];
+		if (t < 0 || t >= h->numTerms)
+		{
+			return NULL;
+		}
+		// the entry is checked before it is used, as the index may be
+		// corrupt in ways the header does not show
+		struct indexTerm *e = &index->terms[t];
+		if (e->hash == hash && e->name >= 0 && e->name < h->stringsSize &&
+			strcmp(index->strings + e->name, term) == 0)
+		{
+			int64_t numBlocks =
+				((int64_t)e->numPostings + POSTING_BLOCK - 1) / POSTING_BLOCK;
+			if (e->numPostings < 0 || e->postings < 0 ||
+				e->postings > h->postingsSize || e->skips < 0 ||
+				e->skips > h->numSkips - numBlocks)
+			{
+				return NULL;
+			}
+			postingList l = fatalAllocate(sizeof(*l));
+			l->data = index->postings + e->postings;
+			l->end = index->postings + h->postingsSize;
+			l->skips = index->skips + e->skips;
+			l->numPostings = e->numPostings;
+			l->maxCount = e->maxCount;
+			l->numBlocks = numBlocks;
+			l->blockSize = 0;
+			l->pos = 0;
+			if (l->numBlocks > 0)
+			{
+				decodeBlock(l, 0);
+			}
+			return l;
+		}
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+int searchIndexNumDocs(searchIndex index)
+{
+	return index->h->numDocs;
+}
+
+const char *searchIndexUrl(searchIndex index, int doc)
+{
+	if (doc < 0 || doc >= index->h->numDocs || index->docs[doc] < 0 ||
+		index->docs[doc] >= index->h->stringsSize)
+	{
+		return NULL;
+	}
+	return index->strings + index->docs[doc];
+}
+
+void postingListFree(postingList l)
+{
+	free(l);
+}
+
+int postingListSize(postingList l)
+{
+	return l->numPostings;
+}
+
+int postingListMaxCount(postingList l)
+{
+	return l->maxCount;
+}
+
+int postingListDoc(postingList l)
+{
+	return l->pos < l->blockSize ? l->docs[l->pos] : -1;
+}
+
+int postingListNext(postingList l)
+{
+	if (l->pos >= l->blockSize)
+	{
+		return -1;
+	}
+	l->pos++;
+	if (l->pos == l->blockSize && l->block + 1 < l->numBlocks)
+	{
+		decodeBlock(l, l->block + 1);
+	}
+	return postingListDoc(l);
+}
+
+int postingListSeek(postingList l, int target)
+{
+	while (l->pos < l->blockSize && l->docs[l->blockSize - 1] < target)
+	{
+		// gallop over the skips of the blocks after this one, with lo the
+		// last block known to end before target
+		int lo = l->block;
+		int step = 1;
+		while (lo + step < l->numBlocks &&
+			   l->skips[lo + step].lastDoc < target)
+		{
+			lo += step;
+			step *= 2;
+		}
+		int hi = lo + step < l->numBlocks ? lo + step : l->numBlocks;
+		while (hi - lo > 1)
+		{
+			int mid = lo + (hi - lo) / 2;
+			if (l->skips[mid].lastDoc < target)
+			{
+				lo = mid;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		if (hi == l->numBlocks)
+		{
+			l->pos = l->blockSize;
+			return -1;
+		}
+		decodeBlock(l, hi);
+	}
+	if (l->pos >= l->blockSize || l->docs[l->pos] >= target)
+	{
+		return postingListDoc(l);
+	}
+
+	// the same within the block, with lo the last posting before target
+	int lo = l->pos;
+	int step = 1;
+	while (lo + step < l->blockSize && l->docs[lo + step] < target)
+	{
+		lo += step;
+		step *= 2;
+	}
+	int hi = lo + step < l->blockSize ? lo + step : l->blockSize - 1;
+	while (hi - lo > 1)
+	{
+		int mid = lo + (hi - lo) / 2;
+		if (l->docs[mid] < target)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	l->pos = hi;
+	return postingListDoc(l);
+}
+
+int postingListsIntersect(postingList *lists, int numLists, int maxDocs,
+						  int *docs)
+{
+	if (numLists == 0)
+	{
+		return 0;
+	}
+	for (int i = 1; i < numLists; i++)
+	{
+		if (lists[i]->numPostings < lists[0]->numPostings)
+		{
+			postingList temp = lists[0];
+			lists[0] = lists[i];
+			lists[i] = temp;
+		}
+	}
+
+	// the shortest list proposes each document, and the others seek to it;
+	// a list that passes it proposes where the shortest list seeks next
+	int count = 0;
+	int target = postingListDoc(lists[0]);
+	while (target >= 0 && count < maxDocs)
+	{
+		int i = 1;
+		while (i < numLists)
+		{
+			int doc = postingListSeek(lists[i], target);
+			if (doc < 0)
+			{
+				return count;
+			}
+			if (doc > target)
+			{
+				break;
+			}
+			i++;
+		}
+		if (i == numLists)
+		{
+			docs[count++] = target;
+			target = postingListSeek(lists[0], target + 1);
+		}
+		else
+		{
+			target = postingListSeek(lists[0], postingListDoc(lists[i]));
+		}
+	}
+	return count;
+}
+
+int postingListsUnion(postingList *lists, int numLists, int *docs,
+					  int *counts)
+{
+	int count = 0;
+	while (true)
+	{
+		int min = -1;
+		for (int i = 0; i < numLists; i++)
+		{
+			int doc = postingListDoc(lists[i]);
+			if (doc >= 0 && (min < 0 || doc < min))
+			{
+				min = doc;
+			}
+		}
+		if (min < 0)
+		{
+			return count;
+		}
+		docs[count] = min;
+		counts[count] = 0;
+		for (int i = 0; i < numLists; i++)
+		{
+			while (postingListDoc(lists[i]) == min)
+			{
+				counts[count]++;
+				postingListNext(lists[i]);
+			}
+		}
+		count++;
+	}
+}
+
+int postingListsTopK(postingList *lists, int numLists, int limit, int k,
+					 int *docs, int *counts)
+{
+	// the lists are ordered by the most a document can score in them, and
+	// bounds[i] is the most it can score in lists 0 to i
+	for (int i = 1; i < numLists; i++)
+	{
+		for (int j = i; j > 0 && lists[j]->maxCount < lists[j - 1]->maxCount;
+			 j--)
+		{
+			postingList temp = lists[j];
+			lists[j] = lists[j - 1];
+			lists[j - 1] = temp;
+		}
+	}
+	int *bounds = fatalAllocate((numLists + 1) * sizeof(int));
+	for (int i = 0; i < numLists; i++)
+	{
+		bounds[i] = (i > 0 ? bounds[i - 1] : 0) + lists[i]->maxCount;
+	}
+
+	// the results so far, in a heap with the one that would be dropped
+	// first at the top: the fewest postings, and then the largest id
+	struct scoredDoc *heap = fatalAllocate((k + 1) * sizeof(struct scoredDoc));
+	int size = 0;
+	int threshold = 0;	// the score a document must beat to get in
+	int essential = 0;	// the first list a document must be in to beat it
+	while (k > 0 && essential < numLists)
+	{
+		int doc = -1;
+		for (int i = essential; i < numLists; i++)
+		{
+			int d = postingListDoc(lists[i]);
+			if (d >= 0 && (doc < 0 || d < doc))
+			{
+				doc = d;
+			}
+		}
+		if (doc < 0 || doc >= limit)
+		{
+			break;
+		}
+		int count = 0;
+		for (int i = essential; i < numLists; i++)
+		{
+			while (postingListDoc(lists[i]) == doc)
+			{
+				count++;
+				postingListNext(lists[i]);
+			}
+		}
+		// the other lists are only sought while they can still lift the
+		// document past the threshold
+		for (int i = essential - 1; i >= 0 && count + bounds[i] > threshold;
+			 i--)
+		{
+			if (postingListSeek(lists[i], doc) == doc)
+			{
+				while (postingListDoc(lists[i]) == doc)
+				{
+					count++;
+					postingListNext(lists[i]);
+				}
+			}
+		}
+
+		// documents come in increasing order, so one that ties with the
+		// top of a full heap loses to it
+		struct scoredDoc d = {doc, count};
+		if (size < k)
+		{
+			heap[size++] = d;
+			siftUp(heap, size - 1);
+		}
+		else if (count > threshold)
+		{
+			heap[0] = d;
+			siftDown(heap, size, 0);
+		}
+		if (size == k)
+		{
+			threshold = heap[0].count;
+			while (essential < numLists && bounds[essential] <= threshold)
+			{
+				essential++;
+			}
+		}
+	}
+
+	qsort(heap, size, sizeof(struct scoredDoc), compareScores);
+	for (int i = 0; i < size; i++)
+	{
+		docs[i] = heap[i].doc;
+		counts[i] = heap[i].count;
+	}
+	free(heap);
+	free(bounds);
+	return size;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Maps the binary index at path into index. Returns false if it is
+// missing or corrupt, or was not built from the text index and the order
+// file with the stamps in source and order.
+static bool mapIndex(searchIndex index, const char *path,
+					 struct fileStamp *source, struct fileStamp *order)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0)
+	{
+		return false;
+	}
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct indexHeader))
+	{
+		close(fd);
+		return false;
+	}
+	index->size = st.st_size;
+	index->base = mmap(NULL, index->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (index->base == MAP_FAILED)
+	{
+		return false;
+	}
+
+	struct indexHeader *h = (struct indexHeader *)index->base;
+	if (!validHeader(h, index->base, index->size) ||
+		memcmp(&h->source, source, sizeof(*source)) != 0 ||
+		memcmp(&h->order, order, sizeof(*order)) != 0)
+	{
+		munmap(index->base, index->size);
+		return false;
+	}
+	index->mapped = true;
+	setSections(index);
+	return true;
+}
+
+// Builds the binary index of the text index at textPath in memory, with
+// the documents numbered by the order file at orderPath if it is not
+// NULL. Stores its size in *size and returns it, or returns NULL if a
+// file cannot be read.
+static char *buildIndex(const char *textPath, const char *orderPath,
+						size_t *size)
+{
+	struct mappedFile text;
+	struct mappedFile order;
+	if (!mapFile(textPath, &text))
+	{
+		return NULL;
+	}
+	if (orderPath != NULL && !mapFile(orderPath, &order))
+	{
+		unmapFile(&text);
+		return NULL;
+	}
+
+	struct indexBuilder b;
+	memset(&b, 0, sizeof(b));
+	b.termIds = MapNew();
+	b.docIds = MapNew();
+	if (orderPath != NULL)
+	{
+		parseOrder(&b, order.data, order.data + order.size);
+		unmapFile(&order);
+	}
+	parseLines(&b, text.data, text.data + text.size);
+	unmapFile(&text);
+	struct fileStamp noOrder = {-1, 0, 0};
+	char *image = layOut(&b, &text.stamp,
+						 orderPath != NULL ? &order.stamp : &noOrder, size);
+
+	MapFree(b.termIds);
+	MapFree(b.docIds);
+	free(b.strings.data);
+	free(b.termNames.data);
+	free(b.docNames.data);
+	free(b.pairTerms.data);
+	free(b.pairDocs.data);
+	return image;
+}
+
+// Numbers the documents in the order of the first tokens of the lines of
+// the order file, from p to end.
+static void parseOrder(struct indexBuilder *b, const char *p,
+					   const char *end)
+{
+	while (p < end)
+	{
+		const char *lineEnd = memchr(p, '\n', end - p);
+		if (lineEnd == NULL)
+		{
+			lineEnd = end;
+		}
+		struct token t;
+		if (nextToken(&p, lineEnd, &t))
+		{
+			findOrAdd(b, b->docIds, &b->docNames, &t);
+		}
+		p = lineEnd < end ? lineEnd + 1 : end;
+	}
+}
+
+// Parses the lines of the text index from p to end. The first token of a
+// line is a term, and the rest are the URLs of the documents it is in.
+static void parseLines(struct indexBuilder *b, const char *p,
+					   const char *end)
+{
+	while (p < end)
+	{
+		const char *lineEnd = memchr(p, '\n', end - p);
+		if (lineEnd == NULL)
+		{
+			lineEnd = end;
+		}
+		struct token t;
+		if (nextToken(&p, lineEnd, &t))
+		{
+			int32_t term = findOrAdd(b, b->termIds, &b->termNames, &t);
+			while (nextToken(&p, lineEnd, &t))
+			{
+				int32_t doc = findOrAdd(b, b->docIds, &b->docNames, &t);
+				append(&b->pairTerms, &term, sizeof(term));
+				append(&b->pairDocs, &doc, sizeof(doc));
+			}
+		}
+		p = lineEnd < end ? lineEnd + 1 : end;
+	}
+}
+
+// Returns the id of the term or document t in ids, adding it with the next
+// id and storing its name if it is new.
+static int32_t findOrAdd(struct indexBuilder *b, Map ids,
+						 struct buffer *names, struct token *t)
+{
+	int id;
+	if (MapFind(ids, t->s, t->len, &id))
+	{
+		return id;
+	}
+	if (names->size / sizeof(int64_t) >= INT32_MAX)
+	{
+		fatalError("too many terms in the inverted index");
+	}
+	id = names->size / sizeof(int64_t);
+	int64_t name = b->strings.size;
+	append(&b->strings, t->s, t->len);
+	append(&b->strings, "", 1);
+	append(names, &name, sizeof(name));
+	MapSet(ids, b->strings.data + name, id);
+	return id;
+}
+
+// Lays out the parsed index as described at the top of this file, with
+// the stamps of the text index and the order file in source and order.
+// Stores its size in *size and returns it.
+static char *layOut(struct indexBuilder *b, struct fileStamp *source,
+					struct fileStamp *order, size_t *size)
+{
+	struct indexHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, INDEX_MAGIC, sizeof(h.magic));
+	h.version = INDEX_VERSION;
+	h.byteOrder = INDEX_BYTE_ORDER;
+	h.numTerms = b->termNames.size / sizeof(int64_t);
+	h.numPostings = b->pairTerms.size / sizeof(int32_t);
+	h.numDocs = b->docNames.size / sizeof(int64_t);
+	h.stringsSize = b->strings.size;
+	h.source = *source;
+	h.order = *order;
+	if (h.numPostings > INT32_MAX)
+	{
+		fatalError("too many postings in the inverted index");
+	}
+
+	// the postings are grouped by term and sorted, then compressed
+	struct indexTerm *terms =
+		fatalAllocate((h.numTerms + 1) * sizeof(struct indexTerm));
+	int32_t *grouped = fatalAllocate((h.numPostings + 1) * sizeof(int32_t));
+	int64_t *termNames = (int64_t *)b->termNames.data;
+	int32_t *pairTerms = (int32_t *)b->pairTerms.data;
+	int32_t *pairDocs = (int32_t *)b->pairDocs.data;
+	memset(terms, 0, (h.numTerms + 1) * sizeof(struct indexTerm));
+	for (int64_t j = 0; j < h.numPostings; j++)
+	{
+		terms[pairTerms[j]].numPostings++;
+	}
+	int64_t start = 0;
+	for (int64_t t = 0; t < h.numTerms; t++)
+	{
+		terms[t].postings = start;
+		start += terms[t].numPostings;
+		terms[t].numPostings = 0;
+	}
+	for (int64_t j = 0; j < h.numPostings; j++)
+	{
+		struct indexTerm *e = &terms[pairTerms[j]];
+		grouped[e->postings + e->numPostings++] = pairDocs[j];
+	}
+	struct buffer stream = {NULL, 0, 0};
+	struct buffer skips = {NULL, 0, 0};
+	for (int64_t t = 0; t < h.numTerms; t++)
+	{
+		int32_t *docs = grouped + terms[t].postings;
+		qsort(docs, terms[t].numPostings, sizeof(int32_t), compareDocs);
+		const char *term = b->strings.data + termNames[t];
+		terms[t].hash = hashTerm(term, strlen(term));
+		terms[t].name = termNames[t];
+		terms[t].postings = stream.size;
+		terms[t].skips = skips.size / sizeof(struct indexSkip);
+		terms[t].maxCount =
+			compressPostings(docs, terms[t].numPostings, &stream, &skips);
+	}
+	free(grouped);
+	h.numSkips = skips.size / sizeof(struct indexSkip);
+	h.postingsSize = stream.size;
+
+	// at most half full, so that probes stay short
+	h.numBuckets = 2;
+	while (h.numBuckets < 2 * h.numTerms)
+	{
+		h.numBuckets *= 2;
+	}
+	h.bucketsAt = align8(sizeof(h));
+	h.termsAt = align8(h.bucketsAt + h.numBuckets * sizeof(int32_t));
+	h.skipsAt = align8(h.termsAt + h.numTerms * sizeof(struct indexTerm));
+	h.postingsAt = align8(h.skipsAt + skips.size);
+	h.docsAt = align8(h.postingsAt + h.postingsSize);
+	h.stringsAt = align8(h.docsAt + h.numDocs * sizeof(int64_t));
+	h.size = h.stringsAt + h.stringsSize;
+
+	char *image = calloc(h.size, 1);
+	if (image == NULL)
+	{
+		fatalError("out of memory");
+	}
+	memcpy(image, &h, sizeof(h));
+	int32_t *buckets = (int32_t *)(image + h.bucketsAt);
+	int64_t mask = h.numBuckets - 1;
+	for (int64_t i = 0; i < h.numBuckets; i++)
+	{
+		buckets[i] = -1;
+	}
+	for (int64_t t = 0; t < h.numTerms; t++)
+	{
+		int64_t i = terms[t].hash & mask;
+		while (buckets[i] >= 0)
+		{
+			i = (i + 1) & mask;
+		}
+		buckets[i] = t;
+	}
+	memcpy(image + h.termsAt, terms, h.numTerms * sizeof(struct indexTerm));
+	memcpy(image + h.skipsAt, skips.data, skips.size);
+	memcpy(image + h.postingsAt, stream.data, stream.size);
+	memcpy(image + h.docsAt, b->docNames.data, b->docNames.size);
+	memcpy(image + h.stringsAt, b->strings.data, b->strings.size);
+	free(terms);
+	free(stream.data);
+	free(skips.data);
+	*size = h.size;
+	return image;
+}
+
+// Appends the n sorted documents of a term to stream, in blocks of
+// POSTING_BLOCK, and a skip for each block to skips. Returns the most
+// times one document is listed.
+static int compressPostings(int32_t *docs, int n, struct buffer *stream,
+							struct buffer *skips)
+{
+	int maxCount = 0;
+	for (int i = 0, run = 0; i < n; i++)
+	{
+		run = (i > 0 && docs[i] == docs[i - 1]) ? run + 1 : 1;
+		maxCount = run > maxCount ? run : maxCount;
+	}
+	size_t start = stream->size;
+	for (int i = 0; i < n; i += POSTING_BLOCK)
+	{
+		int end = i + POSTING_BLOCK < n ? i + POSTING_BLOCK : n;
+		if (stream->size - start > UINT32_MAX)
+		{
+			fatalError("too many postings for one term");
+		}
+		struct indexSkip skip = {docs[end - 1],
+								 (uint32_t)(stream->size - start)};
+		append(skips, &skip, sizeof(skip));
+		appendVarint(stream, docs[i]);
+		for (int j = i + 1; j < end; j++)
+		{
+			appendVarint(stream, docs[j] - docs[j - 1]);
+		}
+	}
+	return maxCount;
+}
+
+// Decodes block b of a posting list and moves to its first posting.
+// A block that runs past the postings section, or that holds documents
+// too large for an int, is cut short.
+static void decodeBlock(postingList l, int b)
+{
+	int n = l->numPostings - b * POSTING_BLOCK;
+	n = n < POSTING_BLOCK ? n : POSTING_BLOCK;
+	const uint8_t *end = l->end;
+	const uint8_t *p = l->skips[b].offset < end - l->data
+						   ? l->data + l->skips[b].offset
+						   : end;
+	uint32_t doc = 0;
+	int i = 0;
+	while (i < n && p < end)
+	{
+		uint32_t delta;
+		if (!readVarint(&p, end, &delta) || delta > INT32_MAX - doc)
+		{
+			break;
+		}
+		doc += delta;
+		l->docs[i++] = doc;
+	}
+	l->block = b;
+	l->blockSize = i;
+	l->pos = 0;
+}
+
+// Whether scored document a would be dropped from a top-k heap before b.
+static bool dropsBefore(struct scoredDoc *a, struct scoredDoc *b)
+{
+	return a->count < b->count || (a->count == b->count && a->doc > b->doc);
+}
+
+// Moves heap[i] up the heap until its parent is dropped before it.
+static void siftUp(struct scoredDoc *heap, int i)
+{
+	while (i > 0 && dropsBefore(&heap[i], &heap[(i - 1) / 2]))
+	{
+		struct scoredDoc temp = heap[i];
+		heap[i] = heap[(i - 1) / 2];
+		heap[(i - 1) / 2] = temp;
+		i = (i - 1) / 2;
+	}
+}
+
+// Moves heap[i] down the heap of the given size until it is dropped
+// before its children.
+static void siftDown(struct scoredDoc *heap, int size, int i)
+{
+	while (true)
+	{
+		int first = i;
+		for (int c = 2 * i + 1; c <= 2 * i + 2 && c < size; c++)
+		{
+			if (dropsBefore(&heap[c], &heap[first]))
+			{
+				first = c;
+			}
+		}
+		if (first == i)
+		{
+			return;
+		}
+		struct scoredDoc temp = heap[i];
+		heap[i] = heap[first];
+		heap[first] = temp;
+		i = first;
+	}
+}
+
+// Orders scored documents by count, most first, and then by id.
+static int compareScores(const void *a, const void *b)
+{
+	const struct scoredDoc *x = a;
+	const struct scoredDoc *y = b;
+	if (x->count != y->count)
+	{
+		return (x->count < y->count) ? 1 : -1;
+	}
+	return (x->doc > y->doc) - (x->doc < y->doc);
+}
+
+// Appends value to a buffer as a varint.
+static void appendVarint(struct buffer *b, uint32_t value)
+{
+	uint8_t bytes[5];
+	int n = 0;
+	while (value >= 0x80)
+	{
+		bytes[n++] = (value & 0x7f) | 0x80;
+		value >>= 7;
+	}
+	bytes[n++] = value;
+	append(b, bytes, n);
+}
+
+// Reads a varint at *p, before end, into *value and advances *p past it.
+// Returns false if it runs past end or does not fit in 32 bits.
+static bool readVarint(const uint8_t **p, const uint8_t *end,
+					   uint32_t *value)
+{
+	const uint8_t *q = *p;
+	uint32_t v = 0;
+	for (int shift = 0; q < end && shift < 32; shift += 7)
+	{
+		uint8_t byte = *q++;
+		v |= (uint32_t)(byte & 0x7f) << shift;
+		if (byte < 0x80)
+		{
+			*value = v;
+			*p = q;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Orders documents by id, for qsort.
+static int compareDocs(const void *a, const void *b)
+{
+	int32_t x = *(const int32_t *)a;
+	int32_t y = *(const int32_t *)b;
+	return (x > y) - (x < y);
+}
+
+// Writes the index to path, through a file next to it that is renamed
+// into place. Failing to write it is not an error, as the index is only
+// built again on the next search.
+static void saveIndex(const char *path, const char *image, size_t size)
+{
+	size_t tempLen = strlen(path) + strlen(".tmp") + 1;
+	char *tempPath = fatalAllocate(tempLen);
+	snprintf(tempPath, tempLen, "%s.tmp", path);
+	FILE *f = fopen(tempPath, "wb");
+	if (f != NULL)
+	{
+		bool ok = fwrite(image, size, 1, f) == 1;
+		ok = fclose(f) == 0 && ok;
+		ok = ok && rename(tempPath, path) == 0;
+		if (!ok)
+		{
+			remove(tempPath);
+		}
+	}
+	free(tempPath);
+}
+
+// Checks the header of a mapped index of the given size, and that its
+// sections lie within it. The entries of the sections are checked as
+// they are used.
+static bool validHeader(struct indexHeader *h, char *base, size_t size)
+{
+	size_t header = sizeof(*h);
+	if (memcmp(h->magic, INDEX_MAGIC, sizeof(h->magic)) != 0 ||
+		h->version != INDEX_VERSION || h->byteOrder != INDEX_BYTE_ORDER ||
+		h->size != (int64_t)size || h->numBuckets <= 0 ||
+		(h->numBuckets & (h->numBuckets - 1)) != 0 || h->numTerms < 0 ||
+		h->numTerms >= h->numBuckets || h->numDocs < 0 ||
+		h->numDocs > INT32_MAX || h->numPostings < 0 ||
+		h->numPostings > INT32_MAX ||
+		!sectionFits(h->size, header, h->bucketsAt, h->numBuckets,
+					 sizeof(int32_t)) ||
+		!sectionFits(h->size, header, h->termsAt, h->numTerms,
+					 sizeof(struct indexTerm)) ||
+		!sectionFits(h->size, header, h->skipsAt, h->numSkips,
+					 sizeof(struct indexSkip)) ||
+		!sectionFits(h->size, header, h->postingsAt, h->postingsSize, 1) ||
+		!sectionFits(h->size, header, h->docsAt, h->numDocs,
+					 sizeof(int64_t)) ||
+		!sectionFits(h->size, header, h->stringsAt, h->stringsSize, 1))
+	{
+		return false;
+	}
+	// every name ends before the end of strings
+	return h->stringsSize == 0 ||
+		   base[h->stringsAt + h->stringsSize - 1] == '\0';
+}
+
+// Points the section pointers of index into its base.
+static void setSections(searchIndex index)
+{
+	index->h = (struct indexHeader *)index->base;
+	index->buckets = (int32_t *)(index->base + index->h->bucketsAt);
+	index->terms = (struct indexTerm *)(index->base + index->h->termsAt);
+	index->skips = (struct indexSkip *)(index->base + index->h->skipsAt);
+	index->postings = (uint8_t *)(index->base + index->h->postingsAt);
+	index->docs = (int64_t *)(index->base + index->h->docsAt);
+	index->strings = index->base + index->h->stringsAt;
+}
+
+// The 32-bit FNV-1a hash, as Map uses. It is part of the index format.
+static uint32_t hashTerm(const char *term, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= (unsigned char)term[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Appends size bytes to a buffer, doubling its capacity as needed.
+static void append(struct buffer *b, const void *data, size_t size)
+{
+	if (b->size + size > b->capacity)
+	{
+		size_t capacity = b->capacity > 0 ? b->capacity : 64;
+		while (b->size + size > capacity)
+		{
+			capacity *= 2;
+		}
+		char *grown = realloc(b->data, capacity);
+		if (grown == NULL)
+		{
+			fatalError("out of memory");
+		}
+		b->data = grown;
+		b->capacity = capacity;
+	}
+	memcpy(b->data + b->size, data, size);
+	b->size += size;
+}
+
+// Rounds at up to a multiple of 8.
+static int64_t align8(int64_t at)
+{
+	return (at + 7) / 8 * 8;
+}
@@ -0,0 +1,101 @@
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <stdbool.h>
+
+// A binary form of invertedIndex.txt that can be mapped into memory and
+// searched in place: a hash table of the terms, each pointing to its
+// postings, the sorted ids of the documents whose lines list it. The
+// postings are compressed, and read through posting lists that decode
+// them a block at a time. Documents can be numbered in the order of
+// another file, such as pageRankList.txt, so that the postings come in
+// that order; the rest are numbered in the order they first appear in
+// the text.
+typedef struct searchIndex *searchIndex;
+
+// A cursor over the postings of one term, in increasing order of document
+// id. A document listed more than once for the term is seen once for each
+// time it is listed.
+typedef struct postingList *postingList;
+
+// Opens the binary index at path, or if it is missing, corrupt or older
+// than the text index at textPath or the order file at orderPath, builds
+// it from them and writes it to path, next to which it is written first
+// and then renamed into place. If the binary index cannot be written,
+// the index built in memory is used anyway. Lines of the text index can
+// be of any length. A term listed on more than one line has the postings
+// of all of them. If orderPath is not NULL, the documents named by the
+// first tokens of its lines are numbered first, from 0, in that order.
+// Returns NULL if the text index or the order file cannot be read.
+searchIndex searchIndexOpen(const char *textPath, const char *orderPath,
+							const char *path);
+
+// Unmaps or frees the index.
+void searchIndexFree(searchIndex index);
+
+// Looks up a term and returns a posting list positioned at its first
+// posting, or NULL if the term is not in the index. The list must be
+// freed before the index.
+// Complexity: O(1) expected
+postingList searchIndexFind(searchIndex index, const char *term);
+
+// Returns the number of documents in the index.
+int searchIndexNumDocs(searchIndex index);
+
+// Returns the URL of document doc, or NULL if there is no such document.
+// The string belongs to the index.
+const char *searchIndexUrl(searchIndex index, int doc);
+
+// Frees a posting list.
+void postingListFree(postingList l);
+
+// Returns the number of postings in the list.
+int postingListSize(postingList l);
+
+// Returns the most times one document is listed in the list.
+int postingListMaxCount(postingList l);
+
+// Returns the document of the current posting, or -1 if the list has been
+// read to the end.
+int postingListDoc(postingList l);
+
+// Moves to the next posting and returns its document, or -1 at the end.
+int postingListNext(postingList l);
+
+// Moves forward to the first posting of a document not less than target
+// and returns its document, or -1 if there is none. Gallops over the skip
+// table to the block that holds it and decodes only that block.
+// Complexity: O(log d) where d is the number of postings skipped
+int postingListSeek(postingList l, int target);
+
+// Stores the first maxDocs documents in all numLists lists in docs, in
+// increasing order and each once, and returns their number. docs must
+// have room for maxDocs documents, or for the size of the shortest list.
+// The lists are read from their current postings and reordered, shortest
+// first, and only the blocks of the longer lists that may hold a
+// document of the shortest are decoded.
+int postingListsIntersect(postingList *lists, int numLists, int maxDocs,
+						  int *docs);
+
+// Stores the documents in any of the numLists lists in docs, in increasing
+// order and each once, with the number of postings of each in counts, and
+// returns their number. docs and counts must have room for the sizes of
+// the lists added up. The lists are read from their current postings.
+int postingListsUnion(postingList *lists, int numLists, int *docs,
+					  int *counts);
+
+// Stores the k documents below limit with the most postings in the
+// numLists lists in docs, with their numbers of postings in counts, and
+// returns how many there are, fewer than k if fewer documents below limit
+// are listed. Documents with more postings come first, and of those with
+// the same number, the one with the smaller id. The lists are read from
+// their current postings in the order of their documents, and reordered.
+// Once k documents are found, a list whose documents can no longer get
+// enough postings to be among the first k is only sought for documents
+// found in the others, using the most times a document is listed in each
+// list as a bound (MaxScore), and the search stops as soon as no document
+// still to come can be.
+int postingListsTopK(postingList *lists, int numLists, int limit, int k,
+					 int *docs, int *counts);
+
+#endif
@@ -1,12 +1,23 @@
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <math.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#define MAXURL 100
-#define MAXLINE 1000
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Map.h"
+#include "fatal.h"
+#include "searchIndex.h"
+
+#define MAXRESULTS 30
 struct url
 {
 	char *s;
@@ -14,23 +25,115 @@ struct url
 	double weight;
 };
 
-int findNumPages(void);
-void initPages(struct url *allUrls, int numPages);
-void checkUrlMatch(char *token, struct url *allUrls, int numPages);
-void findMatches(int numPages, struct url *allUrls, char *argv[], int argc);
-void sortPages(struct url *allUrls, int numPages);
-void printResults(struct url *allUrls, int numPages);
+/**
+ * The pages of pageRankList.txt and the inverted index, with the
+ * documents of the index resolved to pages once, so that a query only
+ * increments counters and only looks at the pages it hits.
+ **/
+struct search
+{
+	struct url *allUrls; // the pages in the order of pageRankList.txt
+	int numPages;
+	searchIndex index;
+	int *docPages;		 // the last page with each document's URL, or -1
+	int *samePages;		 // the previous page with the same URL, or -1
+	int *touched;		 // the pages with hits, in the order they were hit
+	int numTouched;
+	bool rankOrdered;	 // whether page i is document i, for every page
+};
+
+/**
+ * A page with hits, as sortPages orders them.
+ **/
+struct hit
+{
+	int page;
+	int hits;
+};
+
+/**
+ * The time taken by each query a server has answered, in microseconds.
+ **/
+struct latencies
+{
+	double *times;
+	int size;
+	int capacity;
+};
+
+// set by the signal handler when a server should shut down
+static volatile sig_atomic_t stopping = 0;
+
+void initPages(struct search *s);
+void openIndex(struct search *s);
+void countHit(struct search *s, int doc, int count);
+int findLists(struct search *s, char *terms[], int numTerms,
+			  postingList *lists);
+void findMatches(struct search *s, char *terms[], int numTerms);
+void findAllMatches(struct search *s, char *terms[], int numTerms);
+void runQuery(struct search *s, char *terms[], int numTerms, bool matchAll,
+			  FILE *out);
+void answerQuery(struct search *s, char *line, FILE *out);
+void serveStream(struct search *s, FILE *in, FILE *out,
+				 struct latencies *l);
+void serveSocket(struct search *s, const char *path, struct latencies *l);
+void handleStop(int sig);
+void catchStop(void);
+void addLatency(struct latencies *l, double time);
+int compareTimes(const void *a, const void *b);
+void reportLatencies(struct latencies *l);
+int compareHits(const void *a, const void *b);
+void sortPages(struct search *s);
+void printResults(struct search *s, FILE *out);
+void clearHits(struct search *s);
+void freeSearch(struct search *s);
 void freeAllUrls(struct url *allUrls, int numPages);
 
+/**
+ * Usage:
+ *     searchPageRank [-a] term...
+ *     searchPageRank -s
+ *     searchPageRank -S socketPath
+ * With -a, only the pages that have every term are listed. With -s,
+ * pageRankList.txt and the inverted index are loaded once, and then
+ * each line read from stdin is answered as a query, with the terms
+ * separated by spaces and -a allowed before them. Each answer is
+ * printed as searchPageRank prints it, followed by an empty line. With
+ * -S, the queries are read from clients of a Unix socket at socketPath
+ * instead, one client at a time, until SIGINT or SIGTERM. Either
+ * server prints the percentiles of its query latencies to stderr when
+ * it shuts down.
+ **/
 int main(int argc, char *argv[])
 {
-	int numPages = findNumPages();
-	struct url allUrls[numPages];
-	initPages(allUrls, numPages);
-	findMatches(numPages, allUrls, argv, argc);
-	sortPages(allUrls, numPages);
-	printResults(allUrls, numPages);
-	freeAllUrls(allUrls, numPages);
+	struct search s;
+	initPages(&s);
+	openIndex(&s);
+	if ((argc == 2 && strcmp(argv[1], "-s") == 0) ||
+		(argc == 3 && strcmp(argv[1], "-S") == 0))
+	{
+		struct latencies l = {NULL, 0, 0};
+		catchStop();
+		if (argc == 2)
+		{
+			serveStream(&s, stdin, stdout, &l);
+		}
+		else
+		{
+			serveSocket(&s, argv[2], &l);
+		}
+		reportLatencies(&l);
+		free(l.times);
+	}
+	else if (argc > 1 && strcmp(argv[1], "-a") == 0)
+	{
+		runQuery(&s, argv + 2, argc - 2, true, stdout);
+	}
+	else
+	{
+		runQuery(&s, argv + 1, argc - 1, false, stdout);
+	}
+	freeSearch(&s);
 	return 0;
 }
 
@@ -46,139 +149,514 @@ void freeAllUrls(struct url *allUrls, int numPages)
 }
 
 /**
- * Prints the pages and their weights and number of edges to the terminal.
+ * Prints the pages with the most hits, at most MAXRESULTS of them.
  **/
-void printResults(struct url *allUrls, int numPages)
+void printResults(struct search *s, FILE *out)
 {
-	int totalPages = (numPages > 30) ? 30 : numPages;
+	int totalPages =
+		(s->numTouched > MAXRESULTS) ? MAXRESULTS : s->numTouched;
 	for (int j = 0; j < totalPages; j++)
 	{
-		if (allUrls[j].hits > 0)
-		{
-			printf("%s\n", allUrls[j].s);
-		}
+		fprintf(out, "%s\n", s->allUrls[s->touched[j]].s);
 	}
 }
 
 /**
- * Sorts the pages in struct Url by number of hits.
+ * Sorts the pages that were hit by number of hits. Pages with the same
+ * number of hits stay in the order of pageRankList.txt.
  **/
-void sortPages(struct url *allUrls, int numPages)
+void sortPages(struct search *s)
 {
-	for (int i = 0; i < numPages; i++)
+	struct hit *hits = fatalAllocate((s->numTouched + 1) * sizeof(struct hit));
+	for (int j = 0; j < s->numTouched; j++)
 	{
-		for (int j = 0; j < numPages - 1; j++)
-		{
-			if (allUrls[j].hits < allUrls[j + 1].hits)
-			{
-				int temp = allUrls[j].hits;
-				double tempWeight = allUrls[j].weight;
-				char *tempName = allUrls[j].s;
-				allUrls[j].hits = allUrls[j + 1].hits;
-				allUrls[j].weight = allUrls[j + 1].weight;
-				allUrls[j].s = allUrls[j + 1].s;
-				allUrls[j + 1].hits = temp;
-				allUrls[j + 1].weight = tempWeight;
-				allUrls[j + 1].s = tempName;
-			}
-		}
+		hits[j].page = s->touched[j];
+		hits[j].hits = s->allUrls[s->touched[j]].hits;
 	}
+	qsort(hits, s->numTouched, sizeof(struct hit), compareHits);
+	for (int j = 0; j < s->numTouched; j++)
+	{
+		s->touched[j] = hits[j].page;
+	}
+	free(hits);
+}
+
+/**
+ * Orders hits by number of hits, most first, and then by page.
+ **/
+int compareHits(const void *a, const void *b)
+{
+	const struct hit *x = a;
+	const struct hit *y = b;
+	if (x->hits != y->hits)
+	{
+		return (x->hits < y->hits) ? 1 : -1;
+	}
+	return (x->page > y->page) - (x->page < y->page);
 }
 
 /**
- * Reads the pageRankList.txt file and returns the number of pages
- * in the file.
+ * Resets the hits of the pages the last query hit.
  **/
-int findNumPages(void)
+void clearHits(struct search *s)
+{
+	for (int j = 0; j < s->numTouched; j++)
+	{
+		s->allUrls[s->touched[j]].hits = 0;
+	}
+	s->numTouched = 0;
+}
+
+/**
+ * Frees the pages, the index and the tables built from them.
+ **/
+void freeSearch(struct search *s)
+{
+	searchIndexFree(s->index);
+	free(s->docPages);
+	free(s->samePages);
+	free(s->touched);
+	freeAllUrls(s->allUrls, s->numPages);
+	free(s->allUrls);
+}
+
+/**
+ * Reads the pageRankList.txt file, in one pass, and initialises the
+ * pages and their properties. Urls can be of any length.
+ **/
+void initPages(struct search *s)
 {
-	char pageName[MAXURL];
 	FILE *pages = fopen("pageRankList.txt", "r");
 	if (pages == NULL)
 	{
 		fprintf(stderr, "File does not exist!");
-		return EXIT_FAILURE;
+		exit(EXIT_FAILURE);
 	}
-	int numPages = 0;
+	int capacity = 64;
+	s->allUrls = fatalAllocate(capacity * sizeof(struct url));
+	s->numPages = 0;
+	char *pageName;
 	int outD;
 	double weight;
-	while (fscanf(pages, "%s %d %lf", pageName, &outD, &weight) == 3)
+	int n;
+	while ((n = fscanf(pages, "%ms %d %lf", &pageName, &outD, &weight)) >= 1)
 	{
-		numPages++;
+		if (n < 3)
+		{
+			free(pageName);
+			break;
+		}
+		if (s->numPages == capacity)
+		{
+			capacity *= 2;
+			s->allUrls = realloc(s->allUrls, capacity * sizeof(struct url));
+			if (s->allUrls == NULL)
+			{
+				fatalError("out of memory");
+			}
+		}
+		s->allUrls[s->numPages].s = pageName;
+		s->allUrls[s->numPages].hits = 0;
+		s->allUrls[s->numPages].weight = weight;
+		s->numPages++;
 	}
 	fclose(pages);
-	return numPages;
 }
 
 /**
- * Reads the pageRankList.txt file and initialised the pages and their
- * properties into a struct url.
+ * Opens the binary inverted index, which is built from
+ * invertedIndex.txt, with its documents numbered in the order of
+ * pageRankList.txt, whenever either has changed, and finds the page of
+ * each document in it.
  **/
-void initPages(struct url *allUrls, int numPages)
+void openIndex(struct search *s)
 {
-	char pageName[MAXURL];
-	FILE *pages = fopen("pageRankList.txt", "r");
-	if (pages == NULL)
+	s->index = searchIndexOpen("invertedIndex.txt", "pageRankList.txt",
+							   "invertedIndex.bin");
+	if (s->index == NULL)
 	{
 		fprintf(stderr, "File does not exist!");
 		exit(EXIT_FAILURE);
 	}
-	int outD;
-	fseek(pages, 0, SEEK_SET);
-	for (int i = 0; i < numPages; i++)
+	int numDocs = searchIndexNumDocs(s->index);
+	s->docPages = fatalAllocate((numDocs + 1) * sizeof(int));
+	s->samePages = fatalAllocate((s->numPages + 1) * sizeof(int));
+	s->touched = fatalAllocate((s->numPages + 1) * sizeof(int));
+	s->numTouched = 0;
+
+	// pages listed more than once are chained, so that each is hit
+	Map pageIds = MapNew();
+	for (int i = 0; i < s->numPages; i++)
 	{
-		fscanf(pages, "%s %d %lf", pageName, &outD, &allUrls[i].weight);
-		allUrls[i].hits = 0;
-		allUrls[i].s = strdup(pageName);
+		int page;
+		char *url = s->allUrls[i].s;
+		s->samePages[i] =
+			MapFind(pageIds, url, strlen(url), &page) ? page : -1;
+		MapSet(pageIds, url, i);
+	}
+	for (int d = 0; d < numDocs; d++)
+	{
+		const char *url = searchIndexUrl(s->index, d);
+		int page;
+		s->docPages[d] =
+			(url != NULL && MapFind(pageIds, url, strlen(url), &page))
+				? page
+				: -1;
+	}
+	MapFree(pageIds);
+
+	// the documents are numbered in the order of pageRankList.txt, so
+	// unless a URL is listed twice, document d is page d, and the pages
+	// with the most hits can be found without counting every hit
+	s->rankOrdered = true;
+	for (int i = 0; i < s->numPages; i++)
+	{
+		if (s->samePages[i] != -1)
+		{
+			s->rankOrdered = false;
+		}
+	}
+	for (int d = 0; d < numDocs; d++)
+	{
+		if (s->docPages[d] != (d < s->numPages ? d : -1))
+		{
+			s->rankOrdered = false;
+		}
+	}
+}
+
+/**
+ * Increases the number of hits of the pages with the URL of the
+ * given document by count.
+ **/
+void countHit(struct search *s, int doc, int count)
+{
+	if (doc < 0 || doc >= searchIndexNumDocs(s->index))
+	{
+		return;
+	}
+	for (int i = s->docPages[doc]; i >= 0; i = s->samePages[i])
+	{
+		if (s->allUrls[i].hits == 0)
+		{
+			s->touched[s->numTouched++] = i;
+		}
+		s->allUrls[i].hits += count;
 	}
-	fclose(pages);
 }
 
 /**
- * Checks which Urls contain the searched string,
- * if a URL does contain the string increases the number of hits
- * by one.
+ * Looks up the searched strings in the inverted index and stores the
+ * posting lists of those it has in lists. Returns their number.
  **/
-void checkUrlMatch(char *token, struct url *allUrls, int numPages)
+int findLists(struct search *s, char *terms[], int numTerms,
+			  postingList *lists)
 {
-	while (token != NULL)
+	int numLists = 0;
+	for (int i = 0; i < numTerms; i++)
 	{
-		for (int j = 0; j < numPages; j++)
+		postingList l = searchIndexFind(s->index, terms[i]);
+		if (l != NULL)
 		{
-			if (strcmp(token, allUrls[j].s) == 0)
+			lists[numLists++] = l;
+		}
+	}
+	return numLists;
+}
+
+/**
+ * Counts a hit for each Url listed for each of the searched strings.
+ * When the pages are the documents, only the pages that are printed
+ * are counted, and the posting lists are read only until no other page
+ * can get enough hits to be printed.
+ **/
+void findMatches(struct search *s, char *terms[], int numTerms)
+{
+	postingList *lists = fatalAllocate((numTerms + 1) * sizeof(postingList));
+	int numLists = findLists(s, terms, numTerms, lists);
+	if (s->rankOrdered)
+	{
+		// only the pages that are printed are needed, and of those with
+		// the same hits, the ones listed first, which have smaller ids
+		int docs[MAXRESULTS];
+		int counts[MAXRESULTS];
+		int numDocs = postingListsTopK(lists, numLists, s->numPages,
+									   MAXRESULTS, docs, counts);
+		for (int j = 0; j < numDocs; j++)
+		{
+			countHit(s, docs[j], counts[j]);
+		}
+		for (int i = 0; i < numLists; i++)
+		{
+			postingListFree(lists[i]);
+		}
+		free(lists);
+		return;
+	}
+	size_t total = 0;
+	for (int i = 0; i < numLists; i++)
+	{
+		total += postingListSize(lists[i]);
+	}
+	int *docs = fatalAllocate((total + 1) * sizeof(int));
+	int *counts = fatalAllocate((total + 1) * sizeof(int));
+	int numDocs = postingListsUnion(lists, numLists, docs, counts);
+	for (int j = 0; j < numDocs; j++)
+	{
+		countHit(s, docs[j], counts[j]);
+	}
+	for (int i = 0; i < numLists; i++)
+	{
+		postingListFree(lists[i]);
+	}
+	free(lists);
+	free(docs);
+	free(counts);
+}
+
+/**
+ * Finds the Urls listed for every one of the searched strings, and
+ * counts a hit for each string, so that they come out in the order of
+ * pageRankList.txt. Only the parts of the longer posting lists that
+ * may hold a Url of the shortest are read, and when the pages are the
+ * documents, only until the pages that are printed are found.
+ **/
+void findAllMatches(struct search *s, char *terms[], int numTerms)
+{
+	postingList *lists = fatalAllocate((numTerms + 1) * sizeof(postingList));
+	int numLists = findLists(s, terms, numTerms, lists);
+	if (numLists == numTerms && numLists > 0)
+	{
+		int shortest = postingListSize(lists[0]);
+		for (int i = 1; i < numLists; i++)
+		{
+			if (postingListSize(lists[i]) < shortest)
 			{
-				allUrls[j].hits++;
+				shortest = postingListSize(lists[i]);
 			}
 		}
-		token = strtok(NULL, " \n");
+		// in rank order, the first documents found are the pages printed
+		int maxDocs = s->rankOrdered ? MAXRESULTS : shortest;
+		int *docs = fatalAllocate((shortest + 1) * sizeof(int));
+		int numDocs = postingListsIntersect(lists, numLists, maxDocs, docs);
+		for (int j = 0; j < numDocs; j++)
+		{
+			countHit(s, docs[j], numTerms);
+		}
+		free(docs);
+	}
+	for (int i = 0; i < numLists; i++)
+	{
+		postingListFree(lists[i]);
 	}
+	free(lists);
 }
 
 /**
- * Finds tthe corresponding line that contains the the searched
- * strings.
+ * Answers a query of the given terms, and prints the result to out.
  **/
-void findMatches(int numPages, struct url *allUrls, char *argv[], int argc)
+void runQuery(struct search *s, char *terms[], int numTerms, bool matchAll,
+			  FILE *out)
 {
-	FILE *inverted = fopen("invertedIndex.txt", "r");
-	if (inverted == NULL)
+	if (matchAll)
 	{
-		fprintf(stderr, "File does not exist!");
+		findAllMatches(s, terms, numTerms);
+	}
+	else
+	{
+		findMatches(s, terms, numTerms);
+	}
+	sortPages(s);
+	printResults(s, out);
+	clearHits(s);
+}
+
+/**
+ * Answers a query line of a server, and prints the result to out,
+ * followed by an empty line.
+ **/
+void answerQuery(struct search *s, char *line, FILE *out)
+{
+	char **terms = fatalAllocate((strlen(line) / 2 + 1) * sizeof(char *));
+	int numTerms = 0;
+	for (char *term = strtok(line, " \t\r\n"); term != NULL;
+		 term = strtok(NULL, " \t\r\n"))
+	{
+		terms[numTerms++] = term;
+	}
+	bool matchAll = numTerms > 0 && strcmp(terms[0], "-a") == 0;
+	runQuery(s, terms + matchAll, numTerms - matchAll, matchAll, out);
+	fprintf(out, "\n");
+	free(terms);
+}
+
+/**
+ * Answers each line of in as a query, until the end of in or until
+ * the server is stopped, and records how long each took.
+ **/
+void serveStream(struct search *s, FILE *in, FILE *out,
+				 struct latencies *l)
+{
+	char *line = NULL;
+	size_t size = 0;
+	while (!stopping && getline(&line, &size, in) != -1)
+	{
+		struct timespec start;
+		struct timespec end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		answerQuery(s, line, out);
+		fflush(out);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		addLatency(l, (end.tv_sec - start.tv_sec) * 1e6 +
+						  (end.tv_nsec - start.tv_nsec) / 1e3);
+	}
+	free(line);
+}
+
+/**
+ * Listens on a Unix socket at path, and answers the queries of each
+ * client that connects, one client at a time, until the server is
+ * stopped. A socket left at path by an earlier server is replaced.
+ **/
+void serveSocket(struct search *s, const char *path, struct latencies *l)
+{
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "error: socket path '%s' is too long\n", path);
 		exit(EXIT_FAILURE);
 	}
-	char line[MAXLINE];
-	char *token;
-	for (int i = 1; i < argc; i++)
+	strcpy(addr.sun_path, path);
+	struct stat st;
+	if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
 	{
-		fseek(inverted, 0, SEEK_SET);
-		while (fgets(line, MAXLINE, inverted) != NULL)
+		unlink(path);
+	}
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 ||
+		bind(server, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(server, 16) < 0)
+	{
+		fprintf(stderr, "error: cannot listen on '%s': %s\n", path,
+				strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	while (!stopping)
+	{
+		int client = accept(server, NULL, NULL);
+		if (client < 0)
 		{
-			token = strtok(line, " ");
-			if (strcmp(token, argv[i]) == 0)
+			if (errno == EINTR || errno == ECONNABORTED)
 			{
-				token = strtok(NULL, " \n");
-				checkUrlMatch(token, allUrls, numPages);
+				continue;
 			}
+			fprintf(stderr, "error: cannot accept a client: %s\n",
+					strerror(errno));
+			break;
 		}
+		int clientOut = dup(client);
+		FILE *in = fdopen(client, "r");
+		FILE *out = clientOut >= 0 ? fdopen(clientOut, "w") : NULL;
+		if (in != NULL && out != NULL)
+		{
+			serveStream(s, in, out, l);
+		}
+		if (in != NULL)
+		{
+			fclose(in);
+		}
+		else
+		{
+			close(client);
+		}
+		if (out != NULL)
+		{
+			fclose(out);
+		}
+		else if (clientOut >= 0)
+		{
+			close(clientOut);
+		}
+	}
+	close(server);
+	unlink(path);
+}
+
+/**
+ * Stops a server once it has answered the query it is working on.
+ **/
+void handleStop(int sig)
+{
+	(void)sig;
+	stopping = 1;
+}
+
+/**
+ * Makes SIGINT and SIGTERM stop a server. They interrupt a wait for a
+ * query or a client rather than restarting it. A client going away
+ * while its answer is written does not stop the server.
+ **/
+void catchStop(void)
+{
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handleStop;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+}
+
+/**
+ * Records the latency of a query, in microseconds.
+ **/
+void addLatency(struct latencies *l, double time)
+{
+	if (l->size == l->capacity)
+	{
+		l->capacity = (l->capacity > 0) ? l->capacity * 2 : 1024;
+		l->times = realloc(l->times, l->capacity * sizeof(double));
+		if (l->times == NULL)
+		{
+			fatalError("out of memory");
+		}
+	}
+	l->times[l->size++] = time;
+}
+
+/**
+ * Orders latencies from shortest to longest.
+ **/
+int compareTimes(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Prints the number of queries answered and the 50th, 90th, 99th and
+ * 100th percentiles of their latencies to stderr.
+ **/
+void reportLatencies(struct latencies *l)
+{
+	if (l->size == 0)
+	{
+		fprintf(stderr, "0 queries\n");
+		return;
+	}
+	qsort(l->times, l->size, sizeof(double), compareTimes);
+	static const double percentiles[] = {50, 90, 99, 100};
+	fprintf(stderr, "%d queries, latency", l->size);
+	for (int i = 0; i < 4; i++)
+	{
+		// the nearest-rank percentile
+		int rank = (int)ceil(percentiles[i] / 100 * l->size);
+		fprintf(stderr, " p%g %.1fus", percentiles[i],
+				l->times[(rank > 0) ? rank - 1 : 0]);
 	}
-	fclose(inverted);
+	fprintf(stderr, "\n");
 }
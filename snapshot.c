@@ -0,0 +1,311 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fatal.h"
+#include "fileUtil.h"
+#include "graph.h"
+#include "graphPrivate.h"
+#include "snapshot.h"
+
+// Snapshot layout: a header followed by the sections it points to, each
+// starting at a multiple of 8 bytes.
+//   urlOffsets  int64_t[numPages]    where each URL starts in strings
+//   strings     char[stringsSize]    the null-terminated URLs
+//   outDegree   int32_t[numPages]
+//   inDegree    int32_t[numPages]
+//   outOffsets  int32_t[numPages + 1] where each page's out-links start
+//   outLinks    int32_t[numLinks]    the out-links, sorted by source page
+//   stamps      struct fileStamp[numPages] the page files' stamps
+#define SNAPSHOT_MAGIC "PGSNAP\n"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+_Static_assert(sizeof(int) == sizeof(int32_t), "snapshots need 32-bit ints");
+
+struct snapshotHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;	  // SNAPSHOT_BYTE_ORDER as written by the saver
+	int64_t numPages;
+	int64_t numLinks;
+	int64_t stringsSize;
+	struct fileStamp collection;
+	int64_t urlOffsetsAt; // where each section starts in the file
+	int64_t stringsAt;
+	int64_t outDegreeAt;
+	int64_t inDegreeAt;
+	int64_t outOffsetsAt;
+	int64_t outLinksAt;
+	int64_t stampsAt;
+	int64_t size;		  // the size of the whole file
+};
+
+static bool stampPage(const char *dir, const char *name, struct fileStamp *s);
+static bool writeSection(FILE *f, int64_t *at, const void *data, size_t size);
+static bool validStructure(struct snapshotHeader *h, char *base);
+
+////////////////////////////////////////////////////////////////////////
+
+bool pgSaveSnapshot(pageRank pg, const char *dir, const char *path)
+{
+	pgCompileOutLinks(pg);
+	struct snapshotHeader h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	h.version = SNAPSHOT_VERSION;
+	h.byteOrder = SNAPSHOT_BYTE_ORDER;
+	h.numPages = pg->numPages;
+	h.numLinks = pg->outOffsets[pg->numPages];
+	if (!stampPage(dir, "collection", &h.collection))
+	{
+		return false;
+	}
+
+	int64_t *urlOffsets = malloc((pg->numPages + 1) * sizeof(int64_t));
+	struct fileStamp *stamps =
+		malloc((pg->numPages + 1) * sizeof(struct fileStamp));
+	if (urlOffsets == NULL || stamps == NULL)
+	{
+		fatalError("out of memory");
+	}
+	bool ok = true;
+	for (int i = 0; ok && i < pg->numPages; i++)
+	{
+		urlOffsets[i] = h.stringsSize;
+		h.stringsSize += strlen(pg->urls[i]) + 1;
+		ok = stampPage(dir, pg->urls[i], &stamps[i]);
+	}
+
+	size_t tempLen = strlen(path) + strlen(".tmp") + 1;
+	char *tempPath = malloc(tempLen);
+	if (tempPath == NULL)
+	{
+		fatalError("out of memory");
+	}
+	snprintf(tempPath, tempLen, "%s.tmp", path);
+	FILE *f = ok ? fopen(tempPath, "wb") : NULL;
+	if (f != NULL)
+	{
+		// the header is written again once the section offsets are known
+		int64_t at = 0;
+		ok = writeSection(f, &at, &h, sizeof(h)) &&
+			 writeSection(f, &h.urlOffsetsAt, urlOffsets,
+						  pg->numPages * sizeof(int64_t));
+		h.stringsAt = ftell(f);
+		for (int i = 0; ok && i < pg->numPages; i++)
+		{
+			ok = fwrite(pg->urls[i], strlen(pg->urls[i]) + 1, 1, f) == 1;
+		}
+		ok = ok &&
+			 writeSection(f, &h.outDegreeAt, pg->outDegree,
+						  pg->numPages * sizeof(int)) &&
+			 writeSection(f, &h.inDegreeAt, pg->inDegree,
+						  pg->numPages * sizeof(int)) &&
+			 writeSection(f, &h.outOffsetsAt, pg->outOffsets,
+						  (pg->numPages + 1) * sizeof(int)) &&
+			 writeSection(f, &h.outLinksAt, pg->outLinks,
+						  h.numLinks * sizeof(int)) &&
+			 writeSection(f, &h.stampsAt, stamps,
+						  pg->numPages * sizeof(struct fileStamp));
+		h.size = ftell(f);
+		ok = ok && fseek(f, 0, SEEK_SET) == 0 &&
+			 fwrite(&h, sizeof(h), 1, f) == 1;
+		ok = fclose(f) == 0 && ok;
+		ok = ok && rename(tempPath, path) == 0;
+		if (!ok)
+		{
+			remove(tempPath);
+		}
+	}
+	else
+	{
+		ok = false;
+	}
+
+	free(tempPath);
+	free(urlOffsets);
+	free(stamps);
+	return ok;
+}
+
+pageRank pgLoadSnapshot(const char *path, const char *dir)
+{
+	int fd = open(path, O_RDONLY);
+	struct stat st;
+	if (fd < 0)
+	{
+		return NULL;
+	}
+	if (fstat(fd, &st) < 0 ||
+		(size_t)st.st_size < sizeof(struct snapshotHeader))
+	{
+		close(fd);
+		return NULL;
+	}
+	size_t size = st.st_size;
+	char *base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		return NULL;
+	}
+
+	struct snapshotHeader *h = (struct snapshotHeader *)base;
+	if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 ||
+		h->version != SNAPSHOT_VERSION ||
+		h->byteOrder != SNAPSHOT_BYTE_ORDER || h->size != (int64_t)size ||
+		!validStructure(h, base))
+	{
+		munmap(base, size);
+		return NULL;
+	}
+
+	char *strings = base + h->stringsAt;
+	int64_t *urlOffsets = (int64_t *)(base + h->urlOffsetsAt);
+	struct fileStamp *stamps = (struct fileStamp *)(base + h->stampsAt);
+	char **urls = malloc((h->numPages + 1) * sizeof(char *));
+	if (urls == NULL)
+	{
+		fatalError("out of memory");
+	}
+	bool fresh = true;
+	struct fileStamp current;
+	if (dir != NULL)
+	{
+		fresh = stampPage(dir, "collection", &current) &&
+				memcmp(&current, &h->collection, sizeof(current)) == 0;
+	}
+	for (int64_t i = 0; fresh && i < h->numPages; i++)
+	{
+		urls[i] = strings + urlOffsets[i];
+		if (dir != NULL)
+		{
+			fresh = stampPage(dir, urls[i], &current) &&
+					memcmp(&current, &stamps[i], sizeof(current)) == 0;
+		}
+	}
+	if (!fresh)
+	{
+		free(urls);
+		munmap(base, size);
+		return NULL;
+	}
+
+	madvise(base, size, MADV_WILLNEED);
+	return pgNewMapped(base, size, h->numPages, urls,
+					   (int *)(base + h->outDegreeAt),
+					   (int *)(base + h->inDegreeAt),
+					   (int *)(base + h->outOffsetsAt),
+					   (int *)(base + h->outLinksAt));
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Records the size and modification time of dir/<name>.txt.
+static bool stampPage(const char *dir, const char *name, struct fileStamp *s)
+{
+	size_t len = strlen(dir) + 1 + strlen(name) + strlen(".txt") + 1;
+	char *path = malloc(len);
+	if (path == NULL)
+	{
+		fatalError("out of memory");
+	}
+	snprintf(path, len, "%s/%s.txt", dir, name);
+	bool ok = stampFile(path, s);
+	free(path);
+	return ok;
+}
+
+// Writes a section at the next multiple of 8 bytes and records where it
+// starts in *at.
+static bool writeSection(FILE *f, int64_t *at, const void *data, size_t size)
+{
+	static const char padding[8] = {0};
+	long pos = ftell(f);
+	if (pos < 0 || (pos % 8 != 0 && fwrite(padding, 8 - pos % 8, 1, f) != 1))
+	{
+		return false;
+	}
+	*at = ftell(f);
+	return size == 0 || fwrite(data, size, 1, f) == 1;
+}
+
+// Checks that the sections of a snapshot are within the file and that
+// the URLs and out-links refer to valid strings and pages, so a corrupt
+// snapshot is rejected instead of crashing the program.
+static bool validStructure(struct snapshotHeader *h, char *base)
+{
+	int64_t size = h->size;
+	size_t header = sizeof(*h);
+	if (h->numPages < 0 || h->numPages >= INT32_MAX || h->numLinks < 0 ||
+		h->numLinks >= INT32_MAX ||
+		!sectionFits(size, header, h->urlOffsetsAt, h->numPages,
+					 sizeof(int64_t)) ||
+		!sectionFits(size, header, h->stringsAt, h->stringsSize, 1) ||
+		!sectionFits(size, header, h->outDegreeAt, h->numPages,
+					 sizeof(int32_t)) ||
+		!sectionFits(size, header, h->inDegreeAt, h->numPages,
+					 sizeof(int32_t)) ||
+		!sectionFits(size, header, h->outOffsetsAt, h->numPages + 1,
+					 sizeof(int32_t)) ||
+		!sectionFits(size, header, h->outLinksAt, h->numLinks,
+					 sizeof(int32_t)) ||
+		!sectionFits(size, header, h->stampsAt, h->numPages,
+					 sizeof(struct fileStamp)))
+	{
+		return false;
+	}
+	char *strings = base + h->stringsAt;
+	if (h->numPages > 0 &&
+		(h->stringsSize == 0 || strings[h->stringsSize - 1] != '\0'))
+	{
+		return false;
+	}
+
+	int64_t *urlOffsets = (int64_t *)(base + h->urlOffsetsAt);
+	int32_t *outDegree = (int32_t *)(base + h->outDegreeAt);
+	int32_t *outOffsets = (int32_t *)(base + h->outOffsetsAt);
+	int32_t *outLinks = (int32_t *)(base + h->outLinksAt);
+	if (outOffsets[0] != 0 || outOffsets[h->numPages] != h->numLinks)
+	{
+		return false;
+	}
+	for (int64_t i = 0; i < h->numPages; i++)
+	{
+		if (urlOffsets[i] < 0 || urlOffsets[i] >= h->stringsSize ||
+			outOffsets[i + 1] - outOffsets[i] != outDegree[i] ||
+			outDegree[i] < 0)
+		{
+			return false;
+		}
+	}
+	int32_t *inDegree = (int32_t *)(base + h->inDegreeAt);
+	int *counts = calloc(h->numPages + 1, sizeof(int));
+	if (counts == NULL)
+	{
+		fatalError("out of memory");
+	}
+	bool ok = true;
+	for (int64_t j = 0; ok && j < h->numLinks; j++)
+	{
+		ok = outLinks[j] >= 0 && outLinks[j] < h->numPages;
+		if (ok)
+		{
+			counts[outLinks[j]]++;
+		}
+	}
+	for (int64_t i = 0; ok && i < h->numPages; i++)
+	{
+		ok = counts[i] == inDegree[i];
+	}
+	free(counts);
+	return ok;
+}
@@ -0,0 +1,22 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+
+#include "graph.h"
+
+// Saves the URLs, out-links and degrees of a pageRank graph loaded from
+// the collection in dir to a binary snapshot file at path, together with
+// the sizes and modification times of the collection's files. The file
+// is written next to path and renamed into place. Returns false if it
+// cannot be written.
+bool pgSaveSnapshot(pageRank pg, const char *dir, const char *path);
+
+// Maps the snapshot at path and returns a pageRank graph that reads its
+// URLs, out-links and degrees straight from the mapping. If dir is not
+// NULL, the snapshot is only used if the collection's files in dir still
+// have the sizes and modification times recorded in it. Returns NULL if
+// the snapshot is missing, of another version, corrupt or out of date.
+pageRank pgLoadSnapshot(const char *path, const char *dir);
+
+#endif
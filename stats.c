@@ -0,0 +1,253 @@
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "fatal.h"
+#include "stats.h"
+
+#define NUM_HARDWARE_COUNTERS 4
+
+// The totals of a phase over all its runs.
+struct phaseStats
+{
+	int runs;
+	double seconds;
+	uint64_t hardware[NUM_HARDWARE_COUNTERS];
+	struct timespec start; // when the current run started
+	uint64_t hardwareStart[NUM_HARDWARE_COUNTERS];
+};
+
+// Shared by every thread of the process. The counters are atomic, and
+// lock guards everything else once recording has started.
+struct stats
+{
+	atomic_bool enabled;
+	pthread_mutex_t lock;
+	bool hardware; // whether the hardware counters could be opened
+	int hardwareFds[NUM_HARDWARE_COUNTERS];
+	struct phaseStats phases[NUM_STAT_PHASES];
+	atomic_long counters[NUM_STAT_COUNTERS];
+	double *diffs; // the diffPR value of each iteration
+	int numDiffs;
+	int diffCapacity;
+};
+
+static struct stats stats = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+static const char *phaseNames[NUM_STAT_PHASES] = {
+	"load", "reorder", "wInCalc", "wOutCalc", "rankCalculator", "orderUrls",
+};
+static const char *counterNames[NUM_STAT_COUNTERS] = {
+	"pages", "links", "mapLookups", "iterations",
+};
+static const char *hardwareNames[NUM_HARDWARE_COUNTERS] = {
+	"cycles", "instructions", "cacheMisses", "branchMisses",
+};
+static const uint64_t hardwareEvents[NUM_HARDWARE_COUNTERS] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static bool openHardwareCounters(void);
+static void readHardwareCounters(uint64_t *values);
+
+////////////////////////////////////////////////////////////////////////
+
+void statsEnable(bool hardware)
+{
+	pthread_mutex_lock(&stats.lock);
+	for (int c = 0; c < NUM_STAT_COUNTERS; c++)
+	{
+		atomic_store(&stats.counters[c], 0);
+	}
+	stats.hardware = hardware && openHardwareCounters();
+	stats.enabled = true;
+	pthread_mutex_unlock(&stats.lock);
+}
+
+void statsPhaseStart(statPhase phase)
+{
+	if (!stats.enabled)
+	{
+		return;
+	}
+	pthread_mutex_lock(&stats.lock);
+	struct phaseStats *p = &stats.phases[phase];
+	if (stats.hardware)
+	{
+		readHardwareCounters(p->hardwareStart);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &p->start);
+	pthread_mutex_unlock(&stats.lock);
+}
+
+void statsPhaseEnd(statPhase phase)
+{
+	if (!stats.enabled)
+	{
+		return;
+	}
+	pthread_mutex_lock(&stats.lock);
+	struct phaseStats *p = &stats.phases[phase];
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	p->seconds += (end.tv_sec - p->start.tv_sec) +
+				  (end.tv_nsec - p->start.tv_nsec) / 1e9;
+	p->runs++;
+	if (stats.hardware)
+	{
+		uint64_t values[NUM_HARDWARE_COUNTERS];
+		readHardwareCounters(values);
+		for (int h = 0; h < NUM_HARDWARE_COUNTERS; h++)
+		{
+			p->hardware[h] += values[h] - p->hardwareStart[h];
+		}
+	}
+	pthread_mutex_unlock(&stats.lock);
+}
+
+void statsCount(statCounter counter, long n)
+{
+	if (stats.enabled)
+	{
+		atomic_fetch_add_explicit(&stats.counters[counter], n,
+								  memory_order_relaxed);
+	}
+}
+
+void statsSet(statCounter counter, long n)
+{
+	if (stats.enabled)
+	{
+		atomic_store_explicit(&stats.counters[counter], n,
+							  memory_order_relaxed);
+	}
+}
+
+void statsTraceDiff(double diff)
+{
+	if (!stats.enabled)
+	{
+		return;
+	}
+	pthread_mutex_lock(&stats.lock);
+	if (stats.numDiffs == stats.diffCapacity)
+	{
+		int capacity = stats.numDiffs == 0 ? 64 : 2 * stats.numDiffs;
+		double *diffs = realloc(stats.diffs, capacity * sizeof(double));
+		if (diffs == NULL)
+		{
+			pthread_mutex_unlock(&stats.lock);
+			fatalError("out of memory");
+		}
+		stats.diffs = diffs;
+		stats.diffCapacity = capacity;
+	}
+	stats.diffs[stats.numDiffs++] = diff;
+	pthread_mutex_unlock(&stats.lock);
+}
+
+bool statsWrite(const char *path)
+{
+	FILE *f = fopen(path, "w");
+	if (f == NULL)
+	{
+		return false;
+	}
+
+	pthread_mutex_lock(&stats.lock);
+	fprintf(f, "{\n  \"phases\": {\n");
+	for (int p = 0; p < NUM_STAT_PHASES; p++)
+	{
+		struct phaseStats *s = &stats.phases[p];
+		fprintf(f, "    \"%s\": {\"runs\": %d, \"seconds\": %.9f",
+				phaseNames[p], s->runs, s->seconds);
+		if (stats.hardware)
+		{
+			for (int h = 0; h < NUM_HARDWARE_COUNTERS; h++)
+			{
+				fprintf(f, ", \"%s\": %llu", hardwareNames[h],
+						(unsigned long long)s->hardware[h]);
+			}
+		}
+		fprintf(f, "}%s\n", p < NUM_STAT_PHASES - 1 ? "," : "");
+	}
+	fprintf(f, "  },\n  \"hardwareCounters\": %s,\n",
+			stats.hardware ? "true" : "false");
+
+	fprintf(f, "  \"counters\": {");
+	for (int c = 0; c < NUM_STAT_COUNTERS; c++)
+	{
+		fprintf(f, "%s\"%s\": %ld", c > 0 ? ", " : "", counterNames[c],
+				atomic_load(&stats.counters[c]));
+	}
+	fprintf(f, "},\n");
+
+	// %.17g keeps every digit of the differences
+	fprintf(f, "  \"diffPR\": [");
+	for (int i = 0; i < stats.numDiffs; i++)
+	{
+		fprintf(f, "%s%.17g", i > 0 ? ", " : "", stats.diffs[i]);
+	}
+	fprintf(f, "]\n}\n");
+	pthread_mutex_unlock(&stats.lock);
+
+	bool ok = !ferror(f);
+	return fclose(f) == 0 && ok;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Helper Functions
+
+// Opens one counter per hardware event for this process, including the
+// threads it creates later. Returns false if any of them cannot be
+// opened, for example because perf events are not permitted or not
+// supported by a virtual machine.
+static bool openHardwareCounters(void)
+{
+	for (int h = 0; h < NUM_HARDWARE_COUNTERS; h++)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = hardwareEvents[h];
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (fd < 0)
+		{
+			for (int g = 0; g < h; g++)
+			{
+				close(stats.hardwareFds[g]);
+			}
+			return false;
+		}
+		stats.hardwareFds[h] = fd;
+	}
+	return true;
+}
+
+// Reads the current values of the hardware counters.
+static void readHardwareCounters(uint64_t *values)
+{
+	for (int h = 0; h < NUM_HARDWARE_COUNTERS; h++)
+	{
+		if (read(stats.hardwareFds[h], &values[h], sizeof(uint64_t)) !=
+			sizeof(uint64_t))
+		{
+			values[h] = 0;
+		}
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+
+// Process-wide instrumentation: a monotonic timer per phase, counters
+// and the diffPR value of every iteration, written out as JSON. Until
+// statsEnable is called, every function returns straight away, so the
+// hooks cost next to nothing in normal runs. Every function can be called
+// from several threads at once, but the recording is shared by the whole
+// process: if several threads rank at once, their phases overlap and
+// their traces are interleaved.
+
+typedef enum
+{
+	STAT_LOAD,	  // loading the collection or its snapshot
+	STAT_REORDER, // pgReorder
+	STAT_WIN,	  // wInCalc
+	STAT_WOUT,	  // wOutCalc
+	STAT_RANK,	  // rankCalculator
+	STAT_ORDER,	  // orderUrls
+	NUM_STAT_PHASES,
+} statPhase;
+
+typedef enum
+{
+	STAT_PAGES,		  // pages in the ranked graph
+	STAT_LINKS,		  // links in the ranked graph
+	STAT_MAP_LOOKUPS, // URL lookups in the graph's URL map
+	STAT_ITERATIONS,  // iterations run by rankCalculator
+	NUM_STAT_COUNTERS,
+} statCounter;
+
+// Starts recording. If hardware is true, also counts cycles,
+// instructions, cache misses and branch misses per phase with
+// perf_event_open, when the kernel allows it.
+void statsEnable(bool hardware);
+
+// Starts and stops the timer of a phase. Phases that run more than once
+// add up their times.
+void statsPhaseStart(statPhase phase);
+void statsPhaseEnd(statPhase phase);
+
+// Adds n to a counter.
+void statsCount(statCounter counter, long n);
+
+// Sets a counter to n.
+void statsSet(statCounter counter, long n);
+
+// Appends the diffPR value of an iteration to the convergence trace.
+void statsTraceDiff(double diff);
+
+// Writes everything recorded so far to path as a JSON object. Returns
+// false if the file cannot be written.
+bool statsWrite(const char *path);
+
+#endif